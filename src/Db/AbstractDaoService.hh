@@ -120,6 +120,89 @@ abstract class AbstractDaoService<Ta> implements EntityRepo<Ta>
         return $this->getDao()->getInstanceMap($entities);
     }
 
+    /**
+     * Finds several records by some arbitrary criteria, loading only some fields.
+     *
+     * @param $criteria - Field to value pairs
+     * @param $fields - The names of the fields to load; `_id` is always loaded
+     * @param $pagination - Optional pagination parameters
+     * @param $totalCount - Return a `CursorSubset` that includes the total
+     *        number of records. This is only done if `$pagination` is not using
+     *        the defaults.
+     * @return - The partial entities found
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @throws \UnexpectedValueException If the DAO can't load partial entities
+     * @since 0.8.0
+     */
+    public function findAllPartial(\ConstMap<string,mixed> $criteria, \ConstSet<string> $fields, ?\Caridea\Http\Pagination $pagination = null, ?bool $totalCount = false): Traversable<PartialEntity>
+    {
+        return $this->getPartialDao()->findAllPartial($criteria, $fields, $pagination, $totalCount);
+    }
+
+    /**
+     * Gets several documents by ID, loading only some fields.
+     *
+     * @param $ids - Array of identifiers
+     * @param $fields - The names of the fields to load; `_id` is always loaded
+     * @return - The partial entities found
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @throws \UnexpectedValueException If the DAO can't load partial entities
+     * @throws \Caridea\Acl\Exception\Forbidden If the user has no access
+     * @since 0.8.0
+     */
+    public function getAllPartial(\ConstVector<mixed> $ids, \ConstSet<string> $fields): Traversable<PartialEntity>
+    {
+        $all = $this->getPartialDao()->getAllPartial($ids, $fields);
+        $this->gatekeeper->assertAll($this->readPermission, $this->getDao()->getType(), $ids);
+        return $all;
+    }
+
+    /**
+     * Finds several records by some arbitrary criteria, as JSON documents.
+     *
+     * No entities are created and nothing is cached, which makes this useful
+     * for read-only endpoints; see `Labrys\Http\JsonHelper::sendJsonItems`.
+     *
+     * @param $criteria - Field to value pairs
+     * @param $pagination - Optional pagination parameters
+     * @param $totalCount - Return a `CursorSubset` that includes the total
+     *        number of records. This is only done if `$pagination` is not using
+     *        the defaults.
+     * @return - The JSON of each document found
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @throws \UnexpectedValueException If the DAO can't read JSON documents
+     * @since 0.8.0
+     */
+    public function findJson(\ConstMap<string,mixed> $criteria, ?\Caridea\Http\Pagination $pagination = null, ?bool $totalCount = false): \Iterator<string>
+    {
+        $dao = $this->getDao();
+        if (!($dao instanceof JsonRepo)) {
+            throw new \UnexpectedValueException("The DAO cannot read JSON documents");
+        }
+        return $dao->findJson($criteria, $pagination, $totalCount);
+    }
+
+    /**
+     * Gets the DAO as one which can load partial entities.
+     *
+     * @return - The backing DAO
+     * @throws \UnexpectedValueException If the DAO can't load partial entities
+     */
+    private function getPartialDao(): PartialRepo
+    {
+        $dao = $this->getDao();
+        if (!($dao instanceof PartialRepo)) {
+            throw new \UnexpectedValueException("The DAO cannot load partial entities");
+        }
+        return $dao;
+    }
+
     /**
      * Gets the entity and asserts an ACL permission.
      *
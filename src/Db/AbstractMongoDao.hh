@@ -32,7 +32,7 @@ use Labrys\Getter;
 /**
  * Abstract MongoDB DAO Service
  */
-abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>, DbRefResolver<T>, PublisherAware
+abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>, DbRefResolver<T>, PartialRepo, JsonRepo, PublisherAware
 {
     use MongoHelper;
     use \Caridea\Dao\Event\Publishing;
@@ -41,6 +41,10 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      * Whether to enforce optimistic locking
      */
     private bool $versioned = true;
+    /**
+     * Whether optimistic locking is enforced by the update filter
+     */
+    private bool $versionGuard = false;
     /**
      * Whether entities will be put in the first-level cache
      */
@@ -49,10 +53,34 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      * The MongoDB type map when reading records
      */
     private array<string,?string> $typeMap = ['root' => null, 'document' => null];
+    /**
+     * The type used to unserialize projected root documents
+     */
+    private string $partialType = PartialEntity::class;
+    /**
+     * Creates entities from documents, if not done by the typeMap
+     */
+    private ?Hydrator<T> $hydrator;
+    /**
+     * Whether to keep field hashes of loaded documents for dirty checking
+     */
+    private bool $snapshots = false;
+    /**
+     * The field hashes of loaded documents, by identifier
+     */
+    private Map<string,ImmMap<string,string>> $snapshot = Map{};
     /**
      * The MongoDB read preference
      */
     private ?ReadPreference $readPreference;
+    /**
+     * Chooses the read preference per read, if any
+     */
+    private ?ReadRouter $readRouter;
+    /**
+     * The read preference set by `withReadPreference`, if any
+     */
+    private ?ReadPreference $readOverride;
     /**
      * The MongoDB write concern
      */
@@ -60,17 +88,118 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
     /**
      * First-level cache
      */
-    private Map<string,T> $cache = Map{};
+    private EntityCache<T> $cache;
+    /**
+     * Second-level cache shared across requests
+     */
+    private ?SharedDocumentCache $sharedCache;
+    /**
+     * Collects increments to write them in bulk, if any
+     */
+    private ?CounterBuffer $counterBuffer;
+    /**
+     * The position in the profiler of the last cursor read by `doExecute`
+     */
+    private ?int $profiledCursor;
+    /**
+     * The number of identifiers per `$in` query when streaming
+     */
+    private int $batchSize = 1000;
+    /**
+     * Records the commands this DAO runs, if any
+     */
+    private ?Profiler $profiler;
+    /**
+     * Checks queries against declared indexes, if any
+     */
+    private ?IndexAdvisor $indexAdvisor;
+    /**
+     * How totals for paginated queries are counted
+     */
+    private string $countStrategy = self::COUNT_EXACT;
+    /**
+     * The number of seconds a cached count lives
+     */
+    private int $countTtl = 60;
+    /**
+     * Whether totals for paginated queries are counted on first use
+     */
+    private bool $countDeferred = false;
+
+    /**
+     * Totals are counted every time
+     */
+    const string COUNT_EXACT = 'exact';
+    /**
+     * Totals are cached in APC by criteria
+     */
+    const string COUNT_CACHED = 'cached';
+    /**
+     * Totals come from collection metadata when there are no criteria, and
+     * are otherwise cached
+     */
+    const string COUNT_ESTIMATED = 'estimated';
+    /**
+     * The most BSON sent in one bulk write, under MongoDB's 48MB message
+     * limit with room left for the command itself
+     */
+    const int BULK_MAX_BYTES = 47000000;
+    /**
+     * Identifiers waiting to be loaded by the next batch
+     */
+    private Map<string,ObjectID> $pending = Map{};
+    /**
+     * The batch which will load the pending identifiers
+     */
+    private ?Awaitable<ImmMap<string,T>> $batch;
 
     /**
      * Creates a new AbstractMongoDao.
      *
      * Current accepted configuration values:
      * * `versioned` – Whether to enforce optimistic locking via a version field (default: true)
+     * * `versionGuard` – Whether to enforce optimistic locking in the update
+     *   filter rather than by reading the document first (default: false).
+     *   This needs an acknowledged write concern to see whether the update
+     *   matched
      * * `caching` – Whether to cache entities by ID (default: true)
+     * * `cache` – A `Labrys\Db\EntityCache` to use as the first-level cache
+     * * `cacheMaxEntries` – The maximum number of cached entities, if no
+     *   `cache` is specified (default: 0, meaning unlimited)
+     * * `cacheMaxBytes` – The approximate maximum size of cached entities, if
+     *   no `cache` is specified (default: 0, meaning unlimited)
+     * * `sharedCache` – Whether to cache documents across requests in APC, or
+     *   a `Labrys\Db\SharedDocumentCache` to use (default: false)
+     * * `sharedCacheTtl` – The number of seconds documents stay in the shared
+     *   cache (default: 300)
+     * * `counterBuffer` – Whether `doIncrement` collects increments in APC to
+     *   write them in bulk, or a `Labrys\Db\CounterBuffer` to use
+     *   (default: false)
+     * * `snapshots` – Whether to remember a hash of each top-level field of
+     *   loaded documents so `doUpdateSnapshot` sends only what changed
+     *   (default: false)
      * * `typeMapRoot` – The type used to unserialize BSON root documents
      * * `typeMapDocument` – The type used to unserialize BSON nested documents
+     * * `batchSize` – The number of identifiers sent per `$in` query by
+     *   `streamAll` (default: 1000)
+     * * `countStrategy` – How `findAll` and `doProjection` count totals: one of
+     *   `exact`, `cached`, or `estimated` (default: `exact`)
+     * * `countTtl` – The number of seconds cached totals live (default: 60)
+     * * `countDeferred` – Whether totals are counted only once
+     *   `CursorSubset::getTotal` is called, after the query (default: false)
+     * * `hydrator` – A `Labrys\Db\Hydrator` which creates entities from
+     *   documents; when given, `typeMapRoot` is ignored
+     * * `typeMapPartial` – The type used to unserialize projected root
+     *   documents; must implement `MongoDB\BSON\Unserializable` (default:
+     *   `Labrys\Db\PartialEntity`)
+     * * `profiler` – A `Labrys\Db\Profiler` which records each command this
+     *   DAO runs and each first-level cache lookup
+     * * `indexAdvisor` – A `Labrys\Db\IndexAdvisor` which checks the criteria
+     *   and sort of every query against the declared indexes; meant for
+     *   development and staging
      * * `readPreference` – Must be a `MongoDB\Driver\ReadPreference`
+     * * `readRouter` – A `Labrys\Db\ReadRouter` which sends reads to
+     *   secondaries except right after a write; overrides `readPreference`
      * * `writeConcern` – Must be a `MongoDB\Driver\WriteConcern`
      *
      * As for the `typeMap` options, you can see
@@ -80,6 +209,8 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      * @param $manager - The MongoDB Manager
      * @param $collection - The collection to wrap
      * @param $options - Map of configuration values
+     * @throws \InvalidArgumentException if the count strategy is unknown, or
+     *         if `versionGuard` is used with an unacknowledged write concern
      */
     public function __construct(
         Manager $manager,
@@ -87,9 +218,15 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
         ?\ConstMap<string,mixed> $options = null,
     ) {
         parent::__construct($manager, $collection);
+        $cache = $options?->get('cache');
+        $this->cache = $cache instanceof EntityCache ? $cache : new LruEntityCache(
+            (int) ($options?->get('cacheMaxEntries') ?? 0),
+            (int) ($options?->get('cacheMaxBytes') ?? 0)
+        );
         if ($options !== null) {
             $this->versioned = $options->containsKey('version') ?
                 (bool) $options['version'] : true;
+            $this->versionGuard = (bool) ($options['versionGuard'] ?? false);
             $this->caching = $options->containsKey('caching') ?
                 (bool) $options['caching'] : true;
             if ($options->containsKey('typeMapRoot')) {
@@ -100,14 +237,63 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
                 $d = $options['typeMapDocument'];
                 $this->typeMap['document'] = $d === null ? null : (string)$d;
             }
+            $hy = $options['hydrator'] ?? null;
+            if ($hy instanceof Hydrator) {
+                $this->hydrator = $hy;
+                $this->typeMap['root'] = 'array';
+            }
+            if ($options->containsKey('typeMapPartial')) {
+                $this->partialType = (string) $options['typeMapPartial'];
+            }
+            $pr = $options['profiler'] ?? null;
+            if ($pr instanceof Profiler) {
+                $this->profiler = $pr;
+            }
+            $ia = $options['indexAdvisor'] ?? null;
+            if ($ia instanceof IndexAdvisor) {
+                $this->indexAdvisor = $ia;
+            }
             $rp = $options['readPreference'] ?? null;
             if ($rp instanceof ReadPreference) {
                 $this->readPreference = $rp;
             }
+            $rr = $options['readRouter'] ?? null;
+            if ($rr instanceof ReadRouter) {
+                $this->readRouter = $rr;
+            }
             $wc = $options['writeConcern'] ?? null;
             if ($wc instanceof WriteConcern) {
                 $this->writeConcern = $wc;
             }
+            if ($this->versionGuard && ($this->writeConcern ?? $manager->getWriteConcern())->getW() === 0) {
+                throw new \InvalidArgumentException("The versionGuard option can't be used with an unacknowledged write concern");
+            }
+            $this->snapshots = (bool) ($options['snapshots'] ?? false);
+            if ($options->containsKey('batchSize')) {
+                $this->batchSize = max(1, (int) $options['batchSize']);
+            }
+            $cs = (string) ($options['countStrategy'] ?? self::COUNT_EXACT);
+            if ($cs !== self::COUNT_EXACT && $cs !== self::COUNT_CACHED && $cs !== self::COUNT_ESTIMATED) {
+                throw new \InvalidArgumentException("Unknown count strategy: $cs");
+            }
+            $this->countStrategy = $cs;
+            $this->countTtl = (int) ($options['countTtl'] ?? 60);
+            $this->countDeferred = (bool) ($options['countDeferred'] ?? false);
+            $cb = $options['counterBuffer'] ?? null;
+            if ($cb instanceof CounterBuffer) {
+                $this->counterBuffer = $cb;
+            } elseif ($cb === true) {
+                $this->counterBuffer = new CounterBuffer($collection);
+            }
+            $sc = $options['sharedCache'] ?? null;
+            if ($sc instanceof SharedDocumentCache) {
+                $this->sharedCache = $sc;
+            } elseif ($sc === true) {
+                $this->sharedCache = new SharedDocumentCache(
+                    $collection,
+                    (int) ($options['sharedCacheTtl'] ?? 300)
+                );
+            }
         }
         $this->publisher = new \Caridea\Event\NullPublisher();
     }
@@ -117,13 +303,15 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     public function countAll(\ConstMap<string,mixed> $criteria): int
     {
+        $this->indexAdvisor?->check($this->collection, $criteria);
         $result = $this->doExecute(function (Manager $m, string $c) use ($criteria) {
             list($db, $coll) = explode('.', $c, 2);
-            $command = new \MongoDB\Driver\Command([
-                'count' => $coll,
-                'query' => $criteria->toArray(),
-            ]);
-            $cursor = $m->executeCommand($db, $command, $this->readPreference);
+            $cmd = ['count' => $coll];
+            if (!$criteria->isEmpty()) {
+                $cmd['query'] = $criteria->toArray();
+            }
+            $command = new \MongoDB\Driver\Command($cmd);
+            $cursor = $m->executeCommand($db, $command, $this->getReadPreference());
             $cursor->setTypeMap(['root' => 'array']);
             $resa = $cursor->toArray();
             return count($resa) > 0 ? current($resa) : null;
@@ -142,13 +330,14 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     public function findOne(\ConstMap<string,mixed> $criteria) : ?T
     {
+        $this->indexAdvisor?->check($this->collection, $criteria);
         return $this->maybeCache(
             $this->doExecute(function (Manager $m, string $c) use ($criteria) {
                 $q = new \MongoDB\Driver\Query($criteria->toArray(), ['limit' => 1]);
-                $res = $m->executeQuery($c, $q, $this->readPreference);
+                $res = $m->executeQuery($c, $q, $this->getReadPreference());
                 $res->setTypeMap($this->typeMap);
                 $resa = $res->toArray();
-                return count($resa) > 0 ? current($resa) : null;
+                return count($resa) > 0 ? $this->toEntity(current($resa)) : null;
             })
         );
     }
@@ -158,33 +347,56 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     public function findAll(\ConstMap<string,mixed> $criteria, ?\Caridea\Http\Pagination $pagination = null, ?bool $totalCount = false): \Iterator<T>
     {
+        $this->indexAdvisor?->check($this->collection, $criteria, $pagination);
         $total = null;
-        if ($totalCount === true && $pagination !== null && ($pagination->getMax() != PHP_INT_MAX || $pagination->getOffset() > 0)) {
-            $total = $this->countAll($criteria);
+        $counted = $totalCount === true && $this->isPaginated($pagination);
+        if ($counted && !$this->countDeferred) {
+            $total = $this->countTotal($criteria);
         }
         $results = $this->doExecute(function (Manager $m, string $c) use ($criteria, $pagination) {
-            $qo = [];
-            if ($pagination !== null) {
-                if ($pagination->getMax() != PHP_INT_MAX) {
-                    $qo['limit'] = $pagination->getMax();
-                }
-                $qo['skip'] = $pagination->getOffset();
-                $sorts = [];
-                foreach ($pagination->getOrder() as $k => $v) {
-                    $sorts[$k] = $v ? 1 : -1;
-                }
-                if (count($sorts) > 0) {
-                    $qo['sort'] = $sorts;
-                }
-            }
-            $q = new \MongoDB\Driver\Query($criteria->toArray(), $qo);
-            $res = $m->executeQuery($c, $q, $this->readPreference);
+            $q = $this->toQuery($criteria, $pagination);
+            $res = $m->executeQuery($c, $q, $this->getReadPreference());
             $res->setTypeMap($this->typeMap);
             return $res;
         });
+        $results = $this->countRead($results);
+        if ($this->hydrator !== null) {
+            $results = $this->hydrateAll($this->hydrator, $results);
+        }
+        if ($pagination instanceof KeysetPagination) {
+            return $this->toKeysetSubset($results, $pagination, $a ==> $this->toTokenSource($a));
+        }
         /* HH_IGNORE_ERROR[4101]: Cursor will return whatever the user specifies in the typeMap */
         /* HH_IGNORE_ERROR[4029]: Also same thing here */
-        return $total === null ? $results : new CursorSubset($results, $total);
+        return $this->toSubset($results, $criteria, $counted, $total);
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function findJson(\ConstMap<string,mixed> $criteria, ?\Caridea\Http\Pagination $pagination = null, ?bool $totalCount = false): \Iterator<string>
+    {
+        $this->indexAdvisor?->check($this->collection, $criteria, $pagination);
+        $total = null;
+        $counted = $totalCount === true && $this->isPaginated($pagination);
+        if ($counted && !$this->countDeferred) {
+            $total = $this->countTotal($criteria);
+        }
+        $results = $this->doExecute(function (Manager $m, string $c) use ($criteria, $pagination) {
+            $q = $this->toQuery($criteria, $pagination);
+            $res = $m->executeQuery($c, $q, $this->getReadPreference());
+            $res->setTypeMap(['root' => 'array', 'document' => 'array', 'array' => 'array']);
+            return $res;
+        });
+        $results = $this->countRead($results);
+        if ($pagination instanceof KeysetPagination) {
+            $page = $this->toKeysetSubset($results, $pagination);
+            return new KeysetSubset(
+                new ImmVector(self::toJson($page->toArray())),
+                $page->getNextToken()
+            );
+        }
+        return $this->toSubset(self::toJson($results), $criteria, $counted, $total);
     }
 
     /**
@@ -228,12 +440,21 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
             }
             throw $e;
         }
-        $cmp = array_flip($ids->map($a ==> (string) $a));
-        $fromCache = new ImmVector(array_intersect_key($this->cache, $cmp));
-        if (count($fromCache) === count($ids)) {
+        $cached = $this->getAllFromCache($mids->map($a ==> (string) $a));
+        $fromCache = Vector{};
+        $missing = Vector{};
+        foreach ($mids as $mid) {
+            $entity = $cached[(string) $mid] ?? null;
+            if ($entity === null) {
+                $missing[] = $mid;
+            } else {
+                $fromCache[] = $entity;
+            }
+        }
+        if ($missing->isEmpty()) {
             return $fromCache;
-        } elseif (count($fromCache) > 0) {
-            $mids = $mids->filter($a ==> !array_key_exists((string)$a, $this->cache));
+        } elseif (!$fromCache->isEmpty()) {
+            $mids = $missing;
             return $fromCache->concat(
                 $this->maybeCacheAll($this->findAll(ImmMap{'_id' => ['$in' => $mids->toArray()]}))
             );
@@ -242,6 +463,151 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
         }
     }
 
+    /**
+     * {@inheritDoc}
+     *
+     * Partial entities are never put in the first-level cache.
+     */
+    public function findAllPartial(\ConstMap<string,mixed> $criteria, \ConstSet<string> $fields, ?\Caridea\Http\Pagination $pagination = null, ?bool $totalCount = false): \Iterator<PartialEntity>
+    {
+        $projections = Map{};
+        foreach ($fields as $field) {
+            $projections[$field] = 1;
+        }
+        $typeMap = ['root' => $this->partialType, 'document' => $this->typeMap['document']];
+        /* HH_IGNORE_ERROR[4110]: Cursor will return whatever the typeMap specifies */
+        return $this->project($criteria, $projections, $pagination, $totalCount, $typeMap);
+    }
+
+    /**
+     * {@inheritDoc}
+     *
+     * Partial entities are never put in the first-level cache.
+     */
+    public function getAllPartial(\ConstVector<mixed> $ids, \ConstSet<string> $fields): \Iterator<PartialEntity>
+    {
+        if ($ids->isEmpty()) {
+            return new \EmptyIterator();
+        }
+        try {
+            $mids = $this->toIds($ids);
+        } catch (\MongoDB\Driver\Exception\InvalidArgumentException $e) {
+            if ($e->getMessage() === 'Invalid BSON ID provided') {
+                throw new \Caridea\Dao\Exception\Unretrievable('Could not load documents', 0, $e);
+            }
+            throw $e;
+        }
+        return $this->findAllPartial(ImmMap{'_id' => ['$in' => $mids->toArray()]}, $fields);
+    }
+
+    /**
+     * Lazily gets several documents by ID, in the order requested.
+     *
+     * Unlike `getAll`, identifiers are queried in batches of `$in` clauses, and
+     * entities are yielded (and cached) as each batch arrives, so only one
+     * batch is ever held in memory. Identifiers which weren't found are left
+     * out.
+     *
+     * @param $ids - The document identifiers
+     * @param $batchSize - Optional number of identifiers per query, the
+     *        `batchSize` option is used by default
+     * @return - The entities found
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    public function streamAll(\ConstVector<mixed> $ids, ?int $batchSize = null): \Iterator<T>
+    {
+        try {
+            $mids = $this->toIds($ids);
+        } catch (\MongoDB\Driver\Exception\InvalidArgumentException $e) {
+            if ($e->getMessage() === 'Invalid BSON ID provided') {
+                throw new \Caridea\Dao\Exception\Unretrievable('Could not load documents', 0, $e);
+            }
+            throw $e;
+        }
+        return $this->streamBatches($mids, max(1, $batchSize ?? $this->batchSize));
+    }
+
+    /**
+     * Asynchronously gets a single document by ID.
+     *
+     * Every identifier requested through `genById` or `genAll` before the
+     * async scheduler gets around to the next batch is loaded in one `$in`
+     * query, so concurrently awaited lookups cost a single round trip.
+     *
+     * @param $id - The document identifier
+     * @return - The entity or `null` if not found
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    public async function genById(mixed $id): Awaitable<?T>
+    {
+        $entities = await $this->genAll(ImmVector{$id});
+        return $entities->isEmpty() ? null : $entities[0];
+    }
+
+    /**
+     * Asynchronously gets several documents by ID.
+     *
+     * Identifiers are de-duplicated and coalesced with any others requested
+     * in the same scheduler tick. Results are returned in the requested
+     * order; identifiers which weren't found are left out.
+     *
+     * @param $ids - The document identifiers
+     * @return - The entities found
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    public async function genAll(\ConstVector<mixed> $ids): Awaitable<ImmVector<T>>
+    {
+        if ($ids->isEmpty()) {
+            return ImmVector{};
+        }
+        try {
+            $mids = $this->toIds($ids);
+        } catch (\MongoDB\Driver\Exception\InvalidArgumentException $e) {
+            if ($e->getMessage() === 'Invalid BSON ID provided') {
+                throw new \Caridea\Dao\Exception\Unretrievable('Could not load documents', 0, $e);
+            }
+            throw $e;
+        }
+        $found = Map{};
+        $keys = $mids->map($a ==> (string) $a);
+        $cached = $this->getAllFromCache($keys);
+        foreach ($mids as $mid) {
+            $key = (string) $mid;
+            $entity = $cached[$key] ?? null;
+            if ($entity !== null) {
+                $found[$key] = $entity;
+            } elseif (!$found->containsKey($key)) {
+                $this->pending[$key] = $mid;
+            }
+        }
+        // the same ID can be asked for more than once
+        if ($found->count() < $keys->toSet()->count()) {
+            $batch = $this->batch;
+            if ($batch === null) {
+                $batch = $this->genBatch();
+                $this->batch = $batch;
+            }
+            $found->setAll(await $batch);
+        }
+        $results = Vector{};
+        foreach ($mids as $mid) {
+            $entity = $found[(string) $mid] ?? null;
+            if ($entity !== null) {
+                $results[] = $entity;
+            }
+        }
+        return $results->toImmVector();
+    }
+
     /**
      * {@inheritDoc}
      */
@@ -257,7 +623,8 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
     /**
      * Gets the read preference.
      *
-     * If no read preference was specified at creation, this method returns the
+     * This is the one given to `withReadPreference`, or else the one chosen
+     * by the read router, or else the one specified at creation, or else the
      * read preference as returned by the `Manager`.
      *
      * @return - The read preference, or `null`
@@ -265,7 +632,75 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     public function getReadPreference(): ReadPreference
     {
-        return $this->readPreference ?? $this->manager->getReadPreference();
+        return $this->readOverride ?? $this->readRouter?->getReadPreference() ??
+            $this->readPreference ?? $this->manager->getReadPreference();
+    }
+
+    /**
+     * Gets a copy of this DAO which reads using a specific read preference.
+     *
+     * This is meant for single calls, like analytics queries which should
+     * always go to a secondary. The copy shares the caches of this DAO, but
+     * batches its own `genAll` loads.
+     *
+     * ```hack
+     * $report = $dao->withReadPreference(new ReadPreference(ReadPreference::RP_SECONDARY))
+     *     ->findAll($criteria);
+     * ```
+     *
+     * @param $readPreference - The read preference to use
+     * @return - The copy
+     * @since 0.8.0
+     */
+    public function withReadPreference(ReadPreference $readPreference): this
+    {
+        $copy = clone $this;
+        $copy->readOverride = $readPreference;
+        $copy->pending = Map{};
+        $copy->batch = null;
+        return $copy;
+    }
+
+    /**
+     * Runs reads on the primary, whatever the read preference.
+     *
+     * Reads which check a write, like the version for optimistic locking,
+     * must not come from a secondary which may be behind.
+     *
+     * @param $cb - The reads to run
+     * @return - Whatever the function returns
+     */
+    private function onPrimary<Ta>((function(): Ta) $cb): Ta
+    {
+        $override = $this->readOverride;
+        $this->readOverride = new ReadPreference(ReadPreference::RP_PRIMARY);
+        try {
+            return $cb();
+        } finally {
+            $this->readOverride = $override;
+        }
+    }
+
+    /**
+     * Removes all entities from the first-level cache.
+     *
+     * @since 0.8.0
+     */
+    public function clearCache(): void
+    {
+        $this->cache->clear();
+        $this->snapshot->clear();
+    }
+
+    /**
+     * Gets statistics about the first-level cache.
+     *
+     * @return - The cache hit, miss, and eviction counters
+     * @since 0.8.0
+     */
+    public function getCacheStats(): CacheStats
+    {
+        return $this->cache->getStats();
     }
 
     /**
@@ -320,6 +755,97 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
         return $this->getAll($ids);
     }
 
+    /**
+     * Writes inserts, updates, and deletes as a single bulk write.
+     *
+     * This isn't public, so a DAO doesn't gain a write path its own methods
+     * don't check; a subclass opts in by implementing `BulkWritable` with a
+     * `writeBulk` method which calls this one.
+     *
+     * Publishing events are fired as `BulkWritable` describes. If the DAO is
+     * versioned, each update only matches the version its entity was read
+     * with, like `doUpdateModifiable` with a version. When fewer updates
+     * match than were sent, the post events aren't fired and a version
+     * conflict is thrown, though the other operations were written.
+     *
+     * @param $inserts - The documents to insert
+     * @param $updates - The entities to update
+     * @param $deletes - The entities to delete, or their identifiers
+     * @param $ordered - Whether the operations must run in order
+     * @return - Whatever MongoDB returns, or `null` if there was nothing to do
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Conflicting If an update's version check failed
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doWriteBulk(
+        \ConstVector<\MongoDB\BSON\Persistable> $inserts,
+        \ConstVector<Entity\Modifiable> $updates,
+        \ConstVector<mixed> $deletes,
+        bool $ordered = true,
+    ): ?WriteResult {
+        $updates = $updates->filter($a ==> $a->isDirty());
+        // identifiers are loaded, so delete events get an entity like doDelete
+        $ids = $deletes->filter($a ==> !is_object($a) || $a instanceof ObjectID);
+        if (!$ids->isEmpty()) {
+            $deletes = $deletes->filter($a ==> is_object($a) && !($a instanceof ObjectID))->toVector();
+            $deletes->addAll($this->onPrimary(() ==> $this->getAll($ids)));
+        }
+        if ($inserts->isEmpty() && $updates->isEmpty() && $deletes->isEmpty()) {
+            return null;
+        }
+        $bulk = new \MongoDB\Driver\BulkWrite(['ordered' => $ordered]);
+        foreach ($inserts as $record) {
+            $this->preInsert($record);
+            $bulk->insert($record);
+        }
+        $guarded = false;
+        foreach ($updates as $entity) {
+            $mid = Getter::getId($entity);
+            $ops = $entity->getChanges()->map($a ==> $a->toArray())->toArray();
+            $filter = ['_id' => $mid];
+            if ($this->versioned) {
+                $version = Getter::get($entity, 'version');
+                if ($version !== null) {
+                    $filter['version'] = ['$lte' => (int) $version];
+                    $guarded = true;
+                }
+                $ops['$inc']['version'] = 1;
+            }
+            self::checkPaths($ops);
+            $this->preUpdate($entity);
+            $this->uncache((string)$mid);
+            $bulk->update($filter, $ops);
+        }
+        foreach ($deletes as $entity) {
+            $mid = Getter::getId($entity);
+            $this->preDelete($entity);
+            $this->uncache((string)$mid);
+            $bulk->delete(['_id' => $mid], ['limit' => 1]);
+        }
+        $wr = $this->doExecute(function (Manager $m, string $c) use ($bulk) {
+            return $m->executeBulkWrite($c, $bulk, $this->writeConcern);
+        });
+        // another request may have cached a copy read during the write
+        foreach ($updates->concat($deletes) as $entity) {
+            $this->uncache((string) Getter::getId($entity));
+        }
+        if ($guarded && $wr->isAcknowledged() && $wr->getMatchedCount() < $updates->count()) {
+            throw new \Caridea\Dao\Exception\Conflicting("Document version conflict");
+        }
+        foreach ($inserts as $record) {
+            $this->postInsert($record);
+        }
+        foreach ($updates as $entity) {
+            $this->postUpdate($entity);
+        }
+        foreach ($deletes as $entity) {
+            $this->postDelete($entity);
+        }
+        return $wr;
+    }
+
     /**
      * Creates a record.
      *
@@ -367,83 +893,393 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
     }
 
     /**
-     * Updates a record.
+     * Creates many records using MongoDB `Persistable`s.
      *
-     * @param $entity - The entity to update
-     * @param $version - Optional version for optimistic lock checking
-     * @return - Whatever MongoDB returns
+     * Records are read from `$records` as they're needed and sent in batches
+     * of at most `$batchSize` records, and always under the maximum message
+     * size. If the DAO is versioned, each document gets a `version` of 0.
+     * The insert events are fired for every record in a batch before it is
+     * sent, and the post events only for those which were written.
+     *
+     * A write error doesn't stop the other batches; it is counted in the
+     * report for its batch instead.
+     *
+     * @param $records - The documents to insert, ready to go
+     * @param $ordered - Whether a batch stops at its first write error
+     * @param $batchSize - The most records sent in one batch
+     * @return - A report for each batch sent
      * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
-     * @throws \Caridea\Dao\Exception\Conflicting If optimistic/pessimistic lock fails
-     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
      * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
-     * @since 0.5.1
+     * @since 0.8.0
      */
-    protected function doUpdateModifiable(Entity\Modifiable $entity, ?int $version = null): ?WriteResult
+    protected function doCreateAll(Traversable<\MongoDB\BSON\Persistable> $records, bool $ordered = false, int $batchSize = 1000): ImmVector<BulkReport>
     {
-        if (!$entity->isDirty()) {
-            return null;
-        }
-        $mid = Getter::getId($entity);
-        $ops = $entity->getChanges()->map($a ==> $a->toArray())->toArray();
-
-        if ($this->versioned) {
-            if ($version !== null) {
-                $orig = $this->findOne(Map{'_id' => $mid});
-                if ($version < (int) Getter::get($orig, 'version')) {
-                    throw new \Caridea\Dao\Exception\Conflicting("Document version conflict");
-                }
-            }
-            $ops['$inc']['version'] = 1;
-        }
-
-        $this->preUpdate($entity);
-        $this->cache->removeKey((string)$mid);
-        $wr = $this->doExecute(function (Manager $m, string $c) use ($mid, $ops) {
-            $bulk = new \MongoDB\Driver\BulkWrite();
-            $bulk->update(['_id' => $mid], $ops);
-            return $m->executeBulkWrite($c, $bulk, $this->writeConcern);
-        });
-        $this->postUpdate($entity);
-        return $wr;
+        return $this->writeBatches($records, $ordered, max(1, $batchSize), false);
     }
 
     /**
-     * Updates a record.
+     * Creates or replaces the fields of many records using MongoDB `Persistable`s.
      *
-     * @param \MongoDB\BSON\ObjectID|string $id The document identifier, either a string or `ObjectID`
-     * @param $operations - The operations to send to MongoDB
-     * @param $version - Optional version for optimistic lock checking
-     * @return - Whatever MongoDB returns
-     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * This works like `doCreateAll`, except each record is sent as an upsert
+     * by its `_id` which `$set`s every field. If the DAO is versioned, the
+     * `version` is incremented, so a new document starts at 1. No optimistic
+     * lock checking is done. The update events are fired for every record.
+     *
+     * A record with no fields besides its `_id` (and `version`) only creates
+     * the document if it doesn't exist, and leaves an existing one alone.
+     *
+     * @param $records - The documents to upsert, each with an `_id`
+     * @param $ordered - Whether a batch stops at its first write error
+     * @param $batchSize - The most records sent in one batch
+     * @return - A report for each batch sent
+     * @throws \InvalidArgumentException If a record has no `_id`; the batches
+     *         before it are still written
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doUpsertAll(Traversable<\MongoDB\BSON\Persistable> $records, bool $ordered = false, int $batchSize = 1000): ImmVector<BulkReport>
+    {
+        return $this->writeBatches($records, $ordered, max(1, $batchSize), true);
+    }
+
+    /**
+     * Splits records into batches by count and size, and writes each batch.
+     *
+     * @param $records - The documents to write
+     * @param $ordered - Whether a batch stops at its first write error
+     * @param $batchSize - The most records sent in one batch
+     * @param $upsert - Whether to upsert instead of insert
+     * @return - A report for each batch sent
+     */
+    private function writeBatches(Traversable<\MongoDB\BSON\Persistable> $records, bool $ordered, int $batchSize, bool $upsert): ImmVector<BulkReport>
+    {
+        $reports = Vector{};
+        $batch = Vector{};
+        $docs = Vector{};
+        $bytes = 0;
+        foreach ($records as $record) {
+            $doc = (array) $record->bsonSerialize();
+            // this is what the driver would store for a Persistable
+            $pclass = new \MongoDB\BSON\Binary(get_class($record), \MongoDB\BSON\Binary::TYPE_USER_DEFINED);
+            if ($upsert) {
+                if (($doc['_id'] ?? null) === null) {
+                    throw new \InvalidArgumentException("Records to upsert must have an _id");
+                }
+                unset($doc['_id']);
+                unset($doc['version']);
+                if (count($doc) === 0) {
+                    // nothing to change, so only create it if missing
+                    $doc = ['$setOnInsert' => ['__pclass' => $pclass] + ($this->versioned ? ['version' => 1] : [])];
+                } else {
+                    $doc['__pclass'] = $pclass;
+                    $doc = $this->versioned ?
+                        ['$set' => $doc, '$inc' => ['version' => 1]] : ['$set' => $doc];
+                }
+            } else {
+                $doc['__pclass'] = $pclass;
+                if ($this->versioned) {
+                    $doc['version'] = 0;
+                }
+            }
+            $size = strlen(\MongoDB\BSON\fromPHP($doc));
+            if (!$batch->isEmpty() && ($batch->count() >= $batchSize || $bytes + $size > self::BULK_MAX_BYTES)) {
+                $reports[] = $this->writeBatch($batch, $docs, $ordered, $upsert);
+                $batch = Vector{};
+                $docs = Vector{};
+                $bytes = 0;
+            }
+            $batch[] = $record;
+            $docs[] = $doc;
+            $bytes += $size;
+        }
+        if (!$batch->isEmpty()) {
+            $reports[] = $this->writeBatch($batch, $docs, $ordered, $upsert);
+        }
+        return $reports->toImmVector();
+    }
+
+    /**
+     * Writes one batch of records.
+     *
+     * @param $records - The records in the batch
+     * @param $docs - The document or update operations for each record
+     * @param $ordered - Whether the batch stops at its first write error
+     * @param $upsert - Whether to upsert instead of insert
+     * @return - The report for the batch
+     */
+    private function writeBatch(Vector<\MongoDB\BSON\Persistable> $records, Vector<array<string,mixed>> $docs, bool $ordered, bool $upsert): BulkReport
+    {
+        $bulk = new \MongoDB\Driver\BulkWrite(['ordered' => $ordered]);
+        foreach ($records as $i => $record) {
+            if ($upsert) {
+                $mid = Getter::getId($record);
+                $this->preUpdate($record);
+                $this->uncache((string) $mid);
+                $bulk->update(['_id' => $mid], $docs[$i], ['upsert' => true]);
+            } else {
+                $this->preInsert($record);
+                $bulk->insert($docs[$i]);
+            }
+        }
+        $wr = $this->doExecute(function (Manager $m, string $c) use ($bulk) {
+            try {
+                return $m->executeBulkWrite($c, $bulk, $this->writeConcern);
+            } catch (\MongoDB\Driver\Exception\BulkWriteException $e) {
+                // whatever was written is still reported
+                return $e->getWriteResult();
+            }
+        });
+        if ($upsert) {
+            // another request may have cached a copy read during the write
+            foreach ($records as $record) {
+                $this->uncache((string) Getter::getId($record));
+            }
+        }
+        $errors = Map{};
+        foreach ($wr->getWriteErrors() as $error) {
+            $errors[(int) $error->getIndex()] = (string) $error->getMessage();
+        }
+        $count = $records->count();
+        // an ordered batch gives up after its first error
+        $stop = $ordered && !$errors->isEmpty() ? min($errors->keys()->toArray()) : $count;
+        foreach ($records as $i => $record) {
+            if ($i < $stop && !$errors->containsKey($i)) {
+                if ($upsert) {
+                    $this->postUpdate($record);
+                } else {
+                    $this->postInsert($record);
+                }
+            }
+        }
+        $wce = $wr->getWriteConcernError();
+        return shape(
+            'count' => $count,
+            'inserted' => (int) $wr->getInsertedCount(),
+            'upserted' => (int) $wr->getUpsertedCount(),
+            'matched' => (int) $wr->getMatchedCount(),
+            'failed' => $count - $stop + $errors->filterWithKey(($k, $v) ==> $k < $stop)->count(),
+            'errors' => $errors->toImmMap(),
+            'writeConcernError' => $wce === null ? null : (string) $wce->getMessage(),
+        );
+    }
+
+    /**
+     * Updates a record.
+     *
+     * The pre update event is fired before the write. If the write fails,
+     * including a version conflict, the post update event isn't fired.
+     *
+     * @param $entity - The entity to update
+     * @param $version - Optional version for optimistic lock checking
+     * @return - Whatever MongoDB returns
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Conflicting If optimistic/pessimistic lock fails
+     * @throws \Caridea\Dao\Exception\Inoperable If two operations change the same path
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.5.1
+     */
+    protected function doUpdateModifiable(Entity\Modifiable $entity, ?int $version = null): ?WriteResult
+    {
+        if (!$entity->isDirty()) {
+            return null;
+        }
+        $mid = Getter::getId($entity);
+        $ops = $entity->getChanges()->map($a ==> $a->toArray())->toArray();
+        $filter = ['_id' => $mid];
+
+        if ($this->versioned) {
+            if ($version !== null) {
+                if ($this->versionGuard) {
+                    $filter['version'] = ['$lte' => $version];
+                } else {
+                    $orig = $this->onPrimary(() ==> $this->findOne(Map{'_id' => $mid}));
+                    if ($version < (int) Getter::get($orig, 'version')) {
+                        throw new \Caridea\Dao\Exception\Conflicting("Document version conflict");
+                    }
+                }
+            }
+            $ops['$inc']['version'] = 1;
+        }
+
+        self::checkPaths($ops);
+        $this->preUpdate($entity);
+        $this->uncache((string)$mid);
+        $wr = $this->doExecute(function (Manager $m, string $c) use ($filter, $ops) {
+            $bulk = new \MongoDB\Driver\BulkWrite();
+            $bulk->update($filter, $ops);
+            return $m->executeBulkWrite($c, $bulk, $this->writeConcern);
+        });
+        $this->uncache((string)$mid);
+        if (count($filter) > 1) {
+            $this->checkGuarded($mid, $wr);
+        }
+        $this->postUpdate($entity);
+        return $wr;
+    }
+
+    /**
+     * Updates a record.
+     *
+     * @param \MongoDB\BSON\ObjectID|string $id The document identifier, either a string or `ObjectID`
+     * @param $operations - The operations to send to MongoDB
+     * @param $version - Optional version for optimistic lock checking
+     * @return - Whatever MongoDB returns
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
      * @throws \Caridea\Dao\Exception\Unretrievable If the document doesn't exist
      * @throws \Caridea\Dao\Exception\Conflicting If optimistic/pessimistic lock fails
+     * @throws \Caridea\Dao\Exception\Inoperable If two operations change the same path
      * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
      * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
      */
     protected function doUpdate(mixed $id, \ConstMap<string,Map<string,mixed>> $operations, ?int $version = null): WriteResult
     {
-        // ensure record exists
         $mid = $this->toId($id);
-        $orig = $this->get($id);
         $ops = $operations->map($a ==> $a->toArray())->toArray();
+        $filter = ['_id' => $mid];
 
-        // check optimistic locking
-        if ($this->versioned) {
-            if ($version !== null) {
+        if ($this->versionGuard) {
+            // existence and version are checked by the update itself
+            if ($this->versioned && $version !== null) {
+                $filter['version'] = ['$lte' => $version];
+            }
+        } else {
+            // ensure record exists
+            $orig = $this->onPrimary(() ==> $this->get($id));
+            // check optimistic locking
+            if ($this->versioned && $version !== null) {
                 if ($version < (int) Getter::get($orig, 'version')) {
                     throw new \Caridea\Dao\Exception\Conflicting("Document version conflict");
                 }
             }
+        }
+        if ($this->versioned) {
             $ops['$inc']['version'] = 1;
         }
 
         // do update operation
-        $this->cache->removeKey((string)$id);
-        return $this->doExecute(function (Manager $m, string $c) use ($mid, $ops) {
+        self::checkPaths($ops);
+        $this->uncache((string)$id);
+        $wr = $this->doExecute(function (Manager $m, string $c) use ($filter, $ops) {
             $bulk = new \MongoDB\Driver\BulkWrite();
-            $bulk->update(['_id' => $mid], $ops);
+            $bulk->update($filter, $ops);
             return $m->executeBulkWrite($c, $bulk, $this->writeConcern);
         });
+        $this->uncache((string)$id);
+        if ($this->versionGuard) {
+            $this->checkGuarded($mid, $wr);
+        }
+        return $wr;
+    }
+
+    /**
+     * Makes sure no two update operations change the same or nested paths.
+     *
+     * MongoDB rejects such updates, so this saves a failed round trip.
+     *
+     * @param $ops - The update operations
+     * @throws \Caridea\Dao\Exception\Inoperable If a path conflict is found
+     */
+    private static function checkPaths(array<string,mixed> $ops): void
+    {
+        $paths = Set{};
+        foreach ($ops as $op => $fields) {
+            foreach ((array) $fields as $field => $v) {
+                $field = (string) $field;
+                if ($paths->contains($field)) {
+                    throw new \Caridea\Dao\Exception\Inoperable("Update operations conflict at path: $field");
+                }
+                $paths[] = $field;
+            }
+        }
+        foreach ($paths as $path) {
+            $parent = $path;
+            while (($pos = strrpos($parent, '.')) !== false) {
+                $parent = substr($parent, 0, $pos);
+                if ($paths->contains($parent)) {
+                    throw new \Caridea\Dao\Exception\Inoperable("Update operations conflict at paths: $parent and $path");
+                }
+            }
+        }
+    }
+
+    /**
+     * Makes sure a version-guarded update matched its document.
+     *
+     * When nothing matched, the document is counted to tell a missing document
+     * from a version conflict. This only costs a round trip on failure. The
+     * exception is thrown before any post update event, so listeners never
+     * hear about an update which didn't happen.
+     *
+     * @param $mid - The document identifier
+     * @param $wr - The result of the update
+     * @throws \Caridea\Dao\Exception\Unretrievable If the document doesn't exist
+     * @throws \Caridea\Dao\Exception\Conflicting If the version check failed
+     */
+    private function checkGuarded(mixed $mid, WriteResult $wr): void
+    {
+        if ($wr->isAcknowledged() && $wr->getMatchedCount() === 0) {
+            if ($this->onPrimary(() ==> $this->countAll(ImmMap{'_id' => $mid})) === 0) {
+                /* HH_FIXME[4110]: This is stringish */
+                throw new \Caridea\Dao\Exception\Unretrievable("Could not find document with ID $mid");
+            }
+            throw new \Caridea\Dao\Exception\Conflicting("Document version conflict");
+        }
+    }
+
+    /**
+     * Updates a record with only the fields changed since it was loaded.
+     *
+     * This requires the `snapshots` option. Top-level fields whose hash
+     * differs from the snapshot taken at load time are sent with `$set`, and
+     * fields which disappeared are sent with `$unset`. An entity without a
+     * snapshot has all of its fields sent.
+     *
+     * @param $entity - The entity to update
+     * @param $version - Optional version for optimistic lock checking
+     * @return - Whatever MongoDB returns, or `null` if nothing changed
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the document doesn't exist
+     * @throws \Caridea\Dao\Exception\Conflicting If optimistic/pessimistic lock fails
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doUpdateSnapshot(T $entity, ?int $version = null): ?WriteResult
+    {
+        $id = Getter::getId($entity);
+        $key = (string) $id;
+        $before = $this->snapshot[$key] ?? ImmMap{};
+        $after = $this->hashFields($entity);
+        $set = Map{};
+        foreach ($this->toDocument($entity) as $field => $value) {
+            $field = (string) $field;
+            if ($field !== '_id' && $field !== 'version' && ($before[$field] ?? null) !== $after[$field]) {
+                $set[$field] = $value;
+            }
+        }
+        $unset = Map{};
+        foreach ($before as $field => $hash) {
+            if (!$after->containsKey($field) && $field !== '_id' && $field !== 'version') {
+                $unset[$field] = '';
+            }
+        }
+        $ops = Map{};
+        if (!$set->isEmpty()) {
+            $ops['$set'] = $set;
+        }
+        if (!$unset->isEmpty()) {
+            $ops['$unset'] = $unset;
+        }
+        if ($ops->isEmpty()) {
+            return null;
+        }
+        $wr = $this->doUpdate($id, $ops, $version);
+        if ($this->snapshots) {
+            $this->snapshot[$key] = $after;
+        }
+        return $wr;
     }
 
     /**
@@ -458,41 +1294,425 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
     protected function doDelete(mixed $id): WriteResult
     {
         $mid = $this->toId($id);
-        $entity = $this->get($mid);
-        $this->cache->removeKey((string)$id);
+        $entity = $this->onPrimary(() ==> $this->get($mid));
+        $this->uncache((string)$id);
         $this->preDelete($entity);
         $wr = $this->doExecute(function (Manager $m, string $c) use ($mid) {
             $bulk = new \MongoDB\Driver\BulkWrite();
             $bulk->delete(['_id' => $mid], ['limit' => 1]);
             return $m->executeBulkWrite($c, $bulk, $this->writeConcern);
         });
+        $this->uncache((string)$id);
         $this->postDelete($entity);
         return $wr;
     }
 
+    /**
+     * Increments a field of a record, like a view or download count.
+     *
+     * With the `counterBuffer` option, the increment is collected in APC and
+     * written later, in bulk with others, when a flush is due. Otherwise it is
+     * written at once. Either way, no version check is done, the `version`
+     * isn't changed, and no events are fired, since increments commute.
+     *
+     * @param $id - The document identifier, either a string or `ObjectID`
+     * @param $field - The field to increment
+     * @param $amount - The amount to add
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Inoperable If the increment is written at once and fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doIncrement(mixed $id, string $field, int $amount = 1): void
+    {
+        $buffer = $this->counterBuffer;
+        if ($buffer === null) {
+            $rejected = $this->writeIncrements(ImmVector{
+                shape('id' => (string) $id, 'field' => $field, 'amount' => $amount)
+            });
+            if (!$rejected->isEmpty()) {
+                throw new \Caridea\Dao\Exception\Inoperable("Could not increment $field of " . (string) $id);
+            }
+        } elseif ($buffer->increment((string) $id, $field, $amount)) {
+            $this->flushCounters();
+        }
+    }
+
+    /**
+     * Gets the amount of buffered increments not yet written for a field.
+     *
+     * Add this to the value read from the database for an up to date count.
+     *
+     * @param $id - The document identifier, either a string or `ObjectID`
+     * @param $field - The field
+     * @return - The pending amount, 0 without the `counterBuffer` option
+     * @since 0.8.0
+     */
+    public function getPendingIncrement(mixed $id, string $field): int
+    {
+        return $this->counterBuffer?->getPending((string) $id, $field) ?? 0;
+    }
+
+    /**
+     * Writes buffered increments as one unordered bulk write.
+     *
+     * This is done by `doIncrement` when a flush is due, but can also be done
+     * from a scheduled job so quiet counters don't wait.
+     *
+     * Increments which the server rejects are taken out of the buffer and
+     * logged by it, so they aren't retried forever.
+     *
+     * @return - The number of counters written
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    public function flushCounters(): int
+    {
+        return $this->counterBuffer?->flush($a ==> $this->writeIncrements($a)) ?? 0;
+    }
+
+    /**
+     * Sends increments as `$inc` operations, one per record.
+     *
+     * An operation which fails, like one on a field which isn't numeric, or
+     * one for an identifier which isn't an `ObjectID`, doesn't stop the others.
+     *
+     * @param $deltas - The increments
+     * @return - The positions in `$deltas` of the increments which failed
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    private function writeIncrements(\ConstVector<CounterDelta> $deltas): ImmSet<int>
+    {
+        $rejected = Set{};
+        $byId = Map{};
+        $positions = Map{};
+        foreach ($deltas as $i => $delta) {
+            $id = $delta['id'];
+            $fields = $byId[$id] ?? [];
+            $fields[$delta['field']] = (int) ($fields[$delta['field']] ?? 0) + $delta['amount'];
+            $byId[$id] = $fields;
+            if (!$positions->containsKey($id)) {
+                $positions[$id] = Vector{};
+            }
+            $positions[$id][] = $i;
+        }
+        $ops = Vector{};
+        $bulk = new \MongoDB\Driver\BulkWrite(['ordered' => false]);
+        foreach ($byId as $id => $fields) {
+            try {
+                $bulk->update(['_id' => $this->toId($id)], ['$inc' => $fields]);
+                $ops[] = $id;
+            } catch (\MongoDB\Driver\Exception\InvalidArgumentException $e) {
+                $rejected->addAll($positions[$id]);
+            }
+        }
+        if ($ops->isEmpty()) {
+            return $rejected->toImmSet();
+        }
+        $wr = $this->doExecute(function (Manager $m, string $c) use ($bulk) {
+            try {
+                return $m->executeBulkWrite($c, $bulk, $this->writeConcern);
+            } catch (\MongoDB\Driver\Exception\BulkWriteException $e) {
+                // the other operations were still written
+                return $e->getWriteResult();
+            }
+        });
+        foreach ($wr->getWriteErrors() as $error) {
+            $rejected->addAll($positions[$ops[(int) $error->getIndex()]]);
+        }
+        foreach ($ops as $id) {
+            $this->uncache($id);
+        }
+        return $rejected->toImmSet();
+    }
+
+    /**
+     * Atomically updates one record and returns it as changed.
+     *
+     * This takes one round trip with the `findAndModify` command. If the DAO
+     * is versioned, the `version` is incremented. The returned entity replaces
+     * any cached one, and the post update event is fired with it; there is no
+     * entity to send with a pre update event.
+     *
+     * ```hack
+     * $job = $this->doFindAndUpdate(
+     *     Map{'status' => 'waiting'},
+     *     Map{'$set' => Map{'status' => 'claimed', 'worker' => $worker}},
+     *     Map{'created' => true}
+     * );
+     * ```
+     *
+     * @param $criteria - Field to value pairs to find the record
+     * @param $operations - The operations to send to MongoDB
+     * @param $sort - Optional sort order to choose a record if many match
+     * @return - The updated entity, or `null` if none matched
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Inoperable If two operations change the same path
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doFindAndUpdate(\ConstMap<string,mixed> $criteria, \ConstMap<string,Map<string,mixed>> $operations, \ConstMap<string,bool> $sort = ImmMap{}): ?T
+    {
+        return $this->findAndModify($criteria, $operations, $sort, false);
+    }
+
+    /**
+     * Atomically updates or creates one record and returns it as changed.
+     *
+     * This works like `doFindAndUpdate`, except a record is created from the
+     * equality criteria and the operations if none matched. If the DAO is
+     * versioned, a new record starts at `version` 1. The post insert event is
+     * fired for a new record, the post update event otherwise.
+     *
+     * @param $criteria - Field to value pairs to find the record
+     * @param $operations - The operations to send to MongoDB
+     * @param $sort - Optional sort order to choose a record if many match
+     * @return - The updated or created entity
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Inoperable If two operations change the same path
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doFindAndUpsert(\ConstMap<string,mixed> $criteria, \ConstMap<string,Map<string,mixed>> $operations, \ConstMap<string,bool> $sort = ImmMap{}): T
+    {
+        $entity = $this->findAndModify($criteria, $operations, $sort, true);
+        if ($entity === null) {
+            throw new \Caridea\Dao\Exception\Generic("findAndModify did not return the upserted document");
+        }
+        return $entity;
+    }
+
+    /**
+     * Atomically deletes one record and returns it.
+     *
+     * The record is removed from the cache, and the post delete event is
+     * fired with it.
+     *
+     * @param $criteria - Field to value pairs to find the record
+     * @param $sort - Optional sort order to choose a record if many match
+     * @return - The deleted entity, or `null` if none matched
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doFindAndDelete(\ConstMap<string,mixed> $criteria, \ConstMap<string,bool> $sort = ImmMap{}): ?T
+    {
+        return $this->findAndModify($criteria, null, $sort, false);
+    }
+
+    /**
+     * Runs a `findAndModify` command and handles the returned document.
+     *
+     * @param $criteria - Field to value pairs to find the record
+     * @param $operations - The update operations, or `null` to delete
+     * @param $sort - The sort order to choose a record if many match
+     * @param $upsert - Whether to create the record if none matched
+     * @return - The entity returned, or `null` if none matched
+     * @throws \Caridea\Dao\Exception\Generic If the write concern wasn't satisfied
+     */
+    private function findAndModify(\ConstMap<string,mixed> $criteria, ?\ConstMap<string,Map<string,mixed>> $operations, \ConstMap<string,bool> $sort, bool $upsert): ?T
+    {
+        list($db, $coll) = explode('.', $this->collection, 2);
+        $cmd = ['findAndModify' => $coll, 'query' => $criteria->toArray()];
+        if (!$sort->isEmpty()) {
+            $cmd['sort'] = $sort->map($a ==> $a ? 1 : -1)->toArray();
+        }
+        if ($operations === null) {
+            $cmd['remove'] = true;
+        } else {
+            $ops = $operations->map($a ==> $a->toArray())->toArray();
+            if ($this->versioned) {
+                $ops['$inc']['version'] = 1;
+            }
+            self::checkPaths($ops);
+            $cmd['update'] = $ops;
+            $cmd['new'] = true;
+            $cmd['upsert'] = $upsert;
+        }
+        $wc = $this->writeConcern;
+        if ($wc !== null) {
+            $cmd['writeConcern'] = array_filter(
+                ['w' => $wc->getW(), 'wtimeout' => $wc->getWtimeout(), 'j' => $wc->getJournal()],
+                $a ==> $a !== null
+            );
+        }
+        $reply = $this->doExecute(function (Manager $m, string $c) use ($db, $cmd) {
+            $primary = new ReadPreference(ReadPreference::RP_PRIMARY);
+            $res = $m->executeCommand($db, new \MongoDB\Driver\Command($cmd), $primary);
+            // objects keep empty documents from turning into arrays when re-encoded
+            $res->setTypeMap(['root' => 'array', 'document' => 'object', 'array' => 'array']);
+            return current($res->toArray());
+        });
+        $this->readRouter?->recordWrite();
+        $reply = is_array($reply) ? $reply : [];
+        $value = $reply['value'] ?? null;
+        $wce = $reply['writeConcernError'] ?? null;
+        if ($wce !== null) {
+            if (is_object($value)) {
+                $this->uncache((string) Getter::getId($value));
+            }
+            $wce = (array) $wce;
+            throw new \Caridea\Dao\Exception\Generic(
+                'Write concern error: ' . (string) ($wce['errmsg'] ?? ''),
+                (int) ($wce['code'] ?? 0)
+            );
+        }
+        if (!is_object($value)) {
+            return null;
+        }
+        // convert the returned document just like a query would
+        $entity = $this->toEntity(\MongoDB\BSON\toPHP(\MongoDB\BSON\fromPHP($value), $this->typeMap));
+        $this->uncache((string) Getter::getId($entity));
+        if ($operations === null) {
+            $this->postDelete($entity);
+            return $entity;
+        }
+        $this->maybeCache($entity);
+        $status = (array) ($reply['lastErrorObject'] ?? []);
+        if (($status['updatedExisting'] ?? true) === false) {
+            $this->postInsert($entity);
+        } else {
+            $this->postUpdate($entity);
+        }
+        return $entity;
+    }
+
     /**
      * Executes an aggregation command.
      *
+     * Results are returned through a cursor which fetches them in batches.
+     * Besides any aggregation command fields (e.g. `allowDiskUse`), the
+     * following options are accepted:
+     * * `batchSize` – The number of documents per batch
+     *
+     * A `Labrys\Db\Pipeline` can be used to build the stages.
+     *
      * @param $pipeline - The aggregation pipeline operations
      * @param $options - Any aggregation options
+     * @param $typeMap - The type map for results, by default the DAO's
+     * @return - The results cursor
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
      * @see https://docs.mongodb.com/manual/reference/method/db.collection.aggregate/
      * @since 0.7.2
      */
-    protected function doAggregate(Traversable<\ConstMap<string,mixed>> $pipeline, \ConstMap<string,mixed> $options): \MongoDB\Driver\Cursor<mixed>
+    protected function doAggregate(Traversable<\ConstMap<string,mixed>> $pipeline, \ConstMap<string,mixed> $options = ImmMap{}, ?array<string,?string> $typeMap = null): \MongoDB\Driver\Cursor<mixed>
     {
         /* HH_IGNORE_ERROR[4101]: Cursor will return whatever the user specifies in the pipeline */
-        return $this->doExecute(function (Manager $m, string $c) use ($pipeline, $options) {
+        return $this->doExecute(function (Manager $m, string $c) use ($pipeline, $options, $typeMap) {
             list($db, $coll) = explode('.', $c, 2);
-            $cmd = [
-                'aggregate' => $coll,
-                'pipeline' => $options->toArray(),
-            ];
-            foreach ($options as $k => $v) {
+            $command = new \MongoDB\Driver\Command($this->toAggregateCommand($coll, $pipeline, $options));
+            $res = $m->executeCommand($db, $command, $this->getReadPreference());
+            $res->setTypeMap($typeMap ?? $this->typeMap);
+            return $res;
+        });
+    }
+
+    /**
+     * Explains an aggregation command.
+     *
+     * The summary contains:
+     * * `stages` – The names of the pipeline stages the server planned
+     * * `plan` – The names of the query plan stages, e.g. `IXSCAN`
+     * * `indexes` – The names of any indexes used
+     * * `collectionScan` – Whether any part of the plan scans the collection
+     * * `explain` – The complete explain output
+     *
+     * @param $pipeline - The aggregation pipeline operations
+     * @param $options - Any aggregation options
+     * @return - The summary of the plan
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function doExplainAggregate(Traversable<\ConstMap<string,mixed>> $pipeline, \ConstMap<string,mixed> $options = ImmMap{}): ImmMap<string,mixed>
+    {
+        $explain = $this->doExecute(function (Manager $m, string $c) use ($pipeline, $options) {
+            list($db, $coll) = explode('.', $c, 2);
+            $cmd = $this->toAggregateCommand($coll, $pipeline, $options);
+            unset($cmd['cursor']);
+            $cmd['explain'] = true;
+            $res = $m->executeCommand($db, new \MongoDB\Driver\Command($cmd), $this->getReadPreference());
+            $res->setTypeMap(['root' => 'array', 'document' => 'array', 'array' => 'array']);
+            $resa = $res->toArray();
+            return count($resa) > 0 ? current($resa) : [];
+        });
+        $stages = Vector{};
+        foreach ((array) ($explain['stages'] ?? []) as $stage) {
+            if (is_array($stage)) {
+                foreach (array_keys($stage) as $name) {
+                    $stages[] = (string) $name;
+                }
+            }
+        }
+        $plan = Vector{};
+        $indexes = Set{};
+        self::walkPlan($explain, $plan, $indexes);
+        return ImmMap{
+            'stages' => $stages->toImmVector(),
+            'plan' => $plan->toImmVector(),
+            'indexes' => $indexes->toImmSet(),
+            'collectionScan' => $plan->linearSearch('COLLSCAN') !== -1,
+            'explain' => $explain,
+        };
+    }
+
+    /**
+     * Collects query plan stages and index names from explain output.
+     *
+     * @param $node - The explain output, or some part of it
+     * @param $plan - The query plan stage names found
+     * @param $indexes - The index names found
+     */
+    private static function walkPlan(mixed $node, Vector<string> $plan, Set<string> $indexes): void
+    {
+        if (!is_array($node)) {
+            return;
+        }
+        foreach ($node as $k => $v) {
+            if ($k === 'stage' && is_string($v)) {
+                $plan[] = $v;
+            } elseif ($k === 'indexName' && is_string($v)) {
+                $indexes[] = $v;
+            } elseif ($k !== 'rejectedPlans') {
+                self::walkPlan($v, $plan, $indexes);
+            }
+        }
+    }
+
+    /**
+     * Creates the aggregate command document.
+     *
+     * @param $coll - The collection name
+     * @param $pipeline - The aggregation pipeline operations
+     * @param $options - Any aggregation options
+     * @return - The command document
+     */
+    private function toAggregateCommand(string $coll, Traversable<\ConstMap<string,mixed>> $pipeline, \ConstMap<string,mixed> $options): array<string,mixed>
+    {
+        $stages = [];
+        foreach ($pipeline as $stage) {
+            $stages[] = $stage->toArray();
+        }
+        $cmd = [
+            'aggregate' => $coll,
+            'pipeline' => $stages,
+            'cursor' => new \stdClass(),
+        ];
+        foreach ($options as $k => $v) {
+            if ($k === 'batchSize') {
+                $cmd['cursor'] = ['batchSize' => (int) $v];
+            } else {
                 $cmd[$k] = $v;
             }
-            $command = new \MongoDB\Driver\Command($cmd);
-            return $m->executeCommand($db, $command, $this->readPreference);
-        });
+        }
+        return $cmd;
     }
 
     /**
@@ -501,7 +1721,8 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      * @param $criteria - Field to value pairs
      * @param $projections - Field name to projection value (either boolean or
      *        projection operator)
-     * @param $pagination - Optional pagination parameters
+     * @param $pagination - Optional pagination parameters; if this is a
+     *        `KeysetPagination`, a `KeysetSubset` is returned
      * @param $totalCount - Return a `CursorSubset` that includes the total
      *        number of records. This is only done if `$pagination` is not using
      *        the defaults.
@@ -513,34 +1734,238 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     protected function doProjection(\ConstMap<string,mixed> $criteria, \ConstMap<string,mixed> $projections, ?\Caridea\Http\Pagination $pagination = null, ?bool $totalCount = false): \Iterator<mixed>
     {
+        return $this->project($criteria, $projections, $pagination, $totalCount, null);
+    }
+
+    /**
+     * Executes a projection with an optional type map.
+     *
+     * @param $criteria - Field to value pairs
+     * @param $projections - Field name to projection value
+     * @param $pagination - Optional pagination parameters
+     * @param $totalCount - Whether to include the total number of records
+     * @param $typeMap - The type map for the cursor, or `null` for the default
+     * @return - The projection cursor
+     */
+    private function project(\ConstMap<string,mixed> $criteria, \ConstMap<string,mixed> $projections, ?\Caridea\Http\Pagination $pagination, ?bool $totalCount, ?array<string,?string> $typeMap): \Iterator<mixed>
+    {
+        $this->indexAdvisor?->check($this->collection, $criteria, $pagination);
         $total = null;
-        if ($totalCount === true && $pagination !== null && ($pagination->getMax() != PHP_INT_MAX || $pagination->getOffset() > 0)) {
-            $total = $this->countAll($criteria);
+        $counted = $totalCount === true && $this->isPaginated($pagination);
+        if ($counted && !$this->countDeferred) {
+            $total = $this->countTotal($criteria);
         }
-        $results = $this->doExecute(function (Manager $m, string $c) use ($criteria, $projections, $pagination) {
+        $results = $this->doExecute(function (Manager $m, string $c) use ($criteria, $projections, $pagination, $typeMap) {
             $qo = [];
-            if ($pagination !== null) {
-                if ($pagination->getMax() != PHP_INT_MAX) {
-                    $qo['limit'] = $pagination->getMax();
-                }
-                $qo['skip'] = $pagination->getOffset();
-                $sorts = [];
-                foreach ($pagination->getOrder() as $k => $v) {
-                    $sorts[$k] = $v ? 1 : -1;
-                }
-                if (count($sorts) > 0) {
-                    $qo['sort'] = $sorts;
-                }
-            }
             if (!$projections->isEmpty()) {
                 $qo['projection'] = $projections->toArray();
             }
-            $q = new \MongoDB\Driver\Query($criteria->toArray(), $qo);
-            return $m->executeQuery($c, $q, $this->readPreference);
+            $q = $this->toQuery($criteria, $pagination, $qo);
+            $res = $m->executeQuery($c, $q, $this->getReadPreference());
+            if ($typeMap !== null) {
+                $res->setTypeMap($typeMap);
+            }
+            return $res;
         });
+        $results = $this->countRead($results);
+        if ($pagination instanceof KeysetPagination) {
+            return $this->toKeysetSubset($results, $pagination);
+        }
         /* HH_IGNORE_ERROR[4101]: Cursor will return whatever the user specifies in the typeMap */
         /* HH_IGNORE_ERROR[4029]: Also same thing here */
-        return $total === null ? $results : new CursorSubset($results, $total);
+        return $this->toSubset($results, $criteria, $counted, $total);
+    }
+
+    /**
+     * Yields entities one batch of identifiers at a time.
+     *
+     * @param $mids - The document identifiers
+     * @param $batchSize - The number of identifiers per query
+     * @return - The entities found, in the order requested
+     */
+    private function streamBatches(\ConstVector<ObjectID> $mids, int $batchSize): \Generator<int,T,void>
+    {
+        $total = $mids->count();
+        for ($offset = 0; $offset < $total; $offset += $batchSize) {
+            $batch = $mids->slice($offset, $batchSize);
+            $found = $this->getAllFromCache($batch->map($a ==> (string) $a))->toMap();
+            $missing = Map{};
+            foreach ($batch as $mid) {
+                $key = (string) $mid;
+                if (!$found->containsKey($key)) {
+                    $missing[$key] = $mid;
+                }
+            }
+            if (!$missing->isEmpty()) {
+                $entities = $this->findAll(ImmMap{'_id' => ['$in' => $missing->values()->toArray()]});
+                foreach ($entities as $entity) {
+                    $this->maybeCache($entity);
+                    $found[(string) Getter::getId($entity)] = $entity;
+                }
+            }
+            foreach ($batch as $mid) {
+                $entity = $found[(string) $mid] ?? null;
+                if ($entity !== null) {
+                    yield $entity;
+                }
+            }
+        }
+    }
+
+    /**
+     * Loads every pending identifier in a single query.
+     *
+     * Yields to the scheduler first so that other awaitables can add their
+     * identifiers to the batch.
+     *
+     * @return - The entities found, keyed by identifier
+     */
+    private async function genBatch(): Awaitable<ImmMap<string,T>>
+    {
+        await \HH\Asio\later();
+        $mids = $this->pending->values();
+        $this->pending = Map{};
+        $this->batch = null;
+        $found = Map{};
+        if (!$mids->isEmpty()) {
+            $entities = $this->maybeCacheAll(
+                $this->findAll(ImmMap{'_id' => ['$in' => $mids->toArray()]})
+            );
+            foreach ($entities as $entity) {
+                $found[(string) Getter::getId($entity)] = $entity;
+            }
+        }
+        return $found->toImmMap();
+    }
+
+    /**
+     * Wraps results in a `CursorSubset` if a total was requested.
+     *
+     * @param $results - The query results
+     * @param $criteria - The query criteria, for a deferred count
+     * @param $counted - Whether a total was requested
+     * @param $total - The total, or `null` if it's deferred
+     * @return - The results, possibly wrapped
+     */
+    private function toSubset<Ta>(\Iterator<Ta> $results, \ConstMap<string,mixed> $criteria, bool $counted, ?int $total): \Iterator<Ta>
+    {
+        if (!$counted) {
+            return $results;
+        }
+        return $total === null ?
+            CursorSubset::deferred($results, () ==> $this->countTotal($criteria)) :
+            new CursorSubset($results, $total);
+    }
+
+    /**
+     * Counts the total for a paginated query using the count strategy.
+     *
+     * @param $criteria - Field to value pairs
+     * @return - The count of the documents
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    protected function countTotal(\ConstMap<string,mixed> $criteria): int
+    {
+        if ($this->countStrategy === self::COUNT_EXACT ||
+            ($this->countStrategy === self::COUNT_ESTIMATED && $criteria->isEmpty())) {
+            // with no criteria, the count command reads collection metadata
+            return $this->countAll($criteria);
+        }
+        $key = 'labrys:count:' . $this->collection . ':' .
+            md5(\MongoDB\BSON\fromPHP($criteria->toArray()));
+        $total = apc_fetch($key);
+        if (!is_int($total)) {
+            $total = $this->countAll($criteria);
+            apc_store($key, $total, $this->countTtl);
+        }
+        return $total;
+    }
+
+    /**
+     * Whether a total count is meaningful for the pagination.
+     *
+     * @param $pagination - The pagination parameters
+     * @return - Whether the pagination uses offsets and isn't the defaults
+     */
+    private function isPaginated(?\Caridea\Http\Pagination $pagination): bool
+    {
+        return $pagination !== null && !($pagination instanceof KeysetPagination) &&
+            ($pagination->getMax() != PHP_INT_MAX || $pagination->getOffset() > 0);
+    }
+
+    /**
+     * Creates a query with pagination applied.
+     *
+     * A `KeysetPagination` adds a range filter instead of a `skip`.
+     *
+     * @param $criteria - Field to value pairs
+     * @param $pagination - Optional pagination parameters
+     * @param $qo - Any other query options
+     * @return - The query
+     */
+    private function toQuery(\ConstMap<string,mixed> $criteria, ?\Caridea\Http\Pagination $pagination, array<string,mixed> $qo = []): \MongoDB\Driver\Query
+    {
+        $filter = $criteria->toArray();
+        if ($pagination !== null) {
+            if ($pagination->getMax() != PHP_INT_MAX) {
+                $qo['limit'] = $pagination->getMax();
+            }
+            if ($pagination instanceof KeysetPagination) {
+                $seek = $pagination->toFilter();
+                if ($seek !== null) {
+                    $filter = count($filter) > 0 ? ['$and' => [$filter, $seek]] : $seek;
+                }
+            } else {
+                $qo['skip'] = $pagination->getOffset();
+            }
+            $sorts = [];
+            foreach ($pagination->getOrder() as $k => $v) {
+                $sorts[$k] = $v ? 1 : -1;
+            }
+            if (count($sorts) > 0) {
+                $qo['sort'] = $sorts;
+            }
+        }
+        return new \MongoDB\Driver\Query($filter, $qo);
+    }
+
+    /**
+     * Reads a page of keyset results and determines the next page token.
+     *
+     * @param $results - The query results
+     * @param $pagination - The keyset pagination
+     * @param $source - Optional function turning an item into what the token is read from
+     * @return - The page of results
+     */
+    private function toKeysetSubset<Ta>(Traversable<Ta> $results, KeysetPagination $pagination, ?(function(Ta): mixed) $source = null): KeysetSubset<Ta>
+    {
+        $items = new ImmVector($results);
+        $last = $items->lastValue();
+        $next = $last === null || $items->count() < $pagination->getMax() ?
+            null : $pagination->getToken($source === null ? $last : $source($last));
+        return new KeysetSubset($items, $next);
+    }
+
+    /**
+     * Lazily converts documents into JSON.
+     *
+     * Relaxed Extended JSON is used when the driver supports it, so numbers
+     * and strings come out as plain JSON values.
+     *
+     * @param $documents - The documents read as arrays
+     * @return - The JSON of each document
+     */
+    private static function toJson(Traversable<array<string,mixed>> $documents): \Generator<int,string,void>
+    {
+        $relaxed = function_exists('MongoDB\BSON\toRelaxedExtendedJSON');
+        foreach ($documents as $document) {
+            $bson = \MongoDB\BSON\fromPHP($document);
+            /* HH_IGNORE_ERROR[2049]: Only defined by newer drivers */
+            /* HH_IGNORE_ERROR[4107]: Only defined by newer drivers */
+            yield $relaxed ? \MongoDB\BSON\toRelaxedExtendedJSON($bson) : \MongoDB\BSON\toJSON($bson);
+        }
     }
 
     /**
@@ -551,11 +1976,12 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     protected function maybeCache(?T $entity) : ?T
     {
-        if ($this->caching && $entity !== null) {
-            $id = (string) Getter::getId($entity);
-            if (!$this->cache->containsKey($id)) {
-                $this->cache[$id] = $entity;
+        if ($entity !== null) {
+            if ($this->caching) {
+                $this->cache->add((string) Getter::getId($entity), $entity);
             }
+            $this->share($entity);
+            $this->takeSnapshot($entity);
         }
         return $entity;
     }
@@ -568,15 +1994,16 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     protected function maybeCacheAll(\Iterator<T> $entities): Traversable<T>
     {
-        if ($this->caching) {
+        if ($this->caching || $this->sharedCache !== null || $this->snapshots) {
             $results = $entities instanceof \MongoDB\Driver\Cursor ?
                 $entities->toArray() : iterator_to_array($entities, false);
             foreach ($results as $entity) {
-                 if ($entity !== null) {
-                    $id = (string) Getter::getId($entity);
-                    if (!$this->cache->containsKey($id)) {
-                        $this->cache[$id] = $entity;
+                if ($entity !== null) {
+                    if ($this->caching) {
+                        $this->cache->add((string) Getter::getId($entity), $entity);
                     }
+                    $this->share($entity);
+                    $this->takeSnapshot($entity);
                 }
             }
             return $results;
@@ -593,6 +2020,260 @@ abstract class AbstractMongoDao<T> extends MongoDbDao implements EntityRepo<T>,
      */
     protected function getFromCache(string $id) : ?T
     {
-        return $this->cache[$id] ?? null;
+        return $this->getAllFromCache(ImmVector{$id})[$id] ?? null;
+    }
+
+    /**
+     * Gets several entries from the cache
+     *
+     * Entries missing from the first-level cache are fetched from the shared
+     * cache all at once.
+     *
+     * @param $ids - The cache keys
+     * @return - The entities found, by cache key
+     */
+    protected function getAllFromCache(\ConstVector<string> $ids) : ImmMap<string,T>
+    {
+        $found = Map{};
+        $missing = Set{};
+        foreach ($ids as $id) {
+            if ($found->containsKey($id) || $missing->contains($id)) {
+                continue;
+            }
+            $entity = $this->caching ? $this->cache->get($id) : null;
+            if ($this->caching) {
+                $this->profiler?->recordCache($entity !== null);
+            }
+            if ($entity === null) {
+                $missing[] = $id;
+            } else {
+                $found[$id] = $entity;
+            }
+        }
+        if (!$missing->isEmpty() && $this->sharedCache !== null) {
+            foreach ($this->sharedCache->fetchAll($missing->toImmVector()) as $id => $bson) {
+                $entity = $this->toEntity(\MongoDB\BSON\toPHP($bson, $this->typeMap));
+                if ($this->caching) {
+                    $this->cache->add($id, $entity);
+                }
+                $this->takeSnapshot($entity);
+                $found[$id] = $entity;
+            }
+        }
+        return $found->toImmMap();
+    }
+
+    /**
+     * Executes something in the context of the collection.
+     *
+     * If there is a profiler which isn't subscribed to the driver, the call
+     * is timed and recorded under the name of the DAO method which made it,
+     * along with the documents written or returned. Documents from a cursor
+     * are only counted as they're read, if it goes through `countRead`.
+     * A call which returns a `WriteResult` is noted by the read router.
+     *
+     * @param $cb - The closure to execute, takes the Manager and collection
+     * @return - Whatever the function returns, this method also returns
+     * @throws \Caridea\Dao\Exception If a database problem occurs
+     */
+    protected function doExecute<Ta>((function(Manager,string): Ta) $cb): Ta
+    {
+        $profiler = $this->profiler;
+        $timed = $profiler !== null && !$profiler->isSubscribed();
+        $frames = $timed ? debug_backtrace(DEBUG_BACKTRACE_IGNORE_ARGS, 2) : [];
+        $start = microtime(true);
+        $documents = 0;
+        $cursor = false;
+        try {
+            $result = parent::doExecute($cb);
+            if ($result instanceof WriteResult) {
+                $this->readRouter?->recordWrite();
+                $documents = (int) $result->getInsertedCount() + (int) $result->getModifiedCount() +
+                    (int) $result->getUpsertedCount() + (int) $result->getDeletedCount();
+            } elseif ($result instanceof Cursor) {
+                $cursor = true;
+            } elseif (is_array($result) || $result instanceof \Countable) {
+                $documents = count($result);
+            } elseif (is_object($result)) {
+                $documents = 1;
+            }
+            return $result;
+        } finally {
+            if ($timed && $profiler !== null) {
+                $position = $profiler->record(
+                    $this->collection,
+                    (string) ($frames[1]['function'] ?? 'doExecute'),
+                    null,
+                    (microtime(true) - $start) * 1000,
+                    $documents
+                );
+                $this->profiledCursor = $cursor ? $position : null;
+            }
+        }
+    }
+
+    /**
+     * Counts documents into the profiler as they're read from a cursor.
+     *
+     * This only does something for the cursor most recently returned by
+     * `doExecute` while timing for the profiler.
+     *
+     * @param $results - The cursor
+     * @return - The same results
+     */
+    private function countRead<Tv>(\Iterator<Tv> $results): \Iterator<Tv>
+    {
+        $position = $this->profiledCursor;
+        $this->profiledCursor = null;
+        $profiler = $this->profiler;
+        if ($position === null || $profiler === null) {
+            return $results;
+        }
+        return $this->countEach($profiler, $position, $results);
+    }
+
+    /**
+     * Adds each document read to a profiled command.
+     *
+     * @param $profiler - The profiler
+     * @param $position - The position of the command
+     * @param $results - The results
+     * @return - The same results
+     */
+    private function countEach<Tv>(Profiler $profiler, int $position, Traversable<Tv> $results): \Generator<int,Tv,void>
+    {
+        foreach ($results as $result) {
+            $profiler->addDocuments($position, 1);
+            yield $result;
+        }
+    }
+
+    /**
+     * Turns a document read using the typeMap into an entity.
+     *
+     * @param $document - The document
+     * @return - The entity
+     */
+    private function toEntity(mixed $document): T
+    {
+        if ($this->hydrator !== null && is_array($document)) {
+            return $this->hydrator->hydrate($document);
+        }
+        /* HH_IGNORE_ERROR[4110]: BSON will return whatever the user specifies in the typeMap */
+        return $document;
+    }
+
+    /**
+     * Lazily hydrates documents.
+     *
+     * @param $hydrator - The hydrator
+     * @param $documents - The documents
+     * @return - The entities
+     */
+    private function hydrateAll(Hydrator<T> $hydrator, Traversable<array<string,mixed>> $documents): \Generator<int,T,void>
+    {
+        foreach ($documents as $document) {
+            yield $hydrator->hydrate($document);
+        }
+    }
+
+    /**
+     * Removes an entry from the first-level and shared caches.
+     *
+     * @param $id - The cache key
+     */
+    protected function uncache(string $id): void
+    {
+        $this->cache->remove($id);
+        $this->sharedCache?->invalidate($id);
+        $this->snapshot->removeKey($id);
+    }
+
+    /**
+     * Possibly remember the field hashes of an entity.
+     *
+     * @param $entity - The entity as loaded
+     */
+    private function takeSnapshot(T $entity): void
+    {
+        if ($this->snapshots) {
+            $this->snapshot[(string) Getter::getId($entity)] = $this->hashFields($entity);
+        }
+    }
+
+    /**
+     * Hashes each top-level field of an entity's document.
+     *
+     * @param $entity - The entity
+     * @return - The raw MD5 of the BSON of each field, by field name
+     */
+    private function hashFields(T $entity): ImmMap<string,string>
+    {
+        $hashes = Map{};
+        foreach ($this->toDocument($entity) as $field => $value) {
+            $hashes[(string) $field] = md5(\MongoDB\BSON\fromPHP(['v' => $value]), true);
+        }
+        return $hashes->toImmMap();
+    }
+
+    /**
+     * Gets the top-level fields of an entity's document.
+     *
+     * @param $entity - The entity
+     * @return - The document fields
+     */
+    private function toDocument(T $entity): KeyedTraversable<arraykey,mixed>
+    {
+        if ($this->hydrator !== null) {
+            return $this->hydrator->extract($entity);
+        } elseif ($entity instanceof \MongoDB\BSON\Serializable) {
+            return (array) $entity->bsonSerialize();
+        } elseif (is_array($entity)) {
+            return $entity;
+        } elseif (is_object($entity)) {
+            return get_object_vars($entity);
+        }
+        return [];
+    }
+
+    /**
+     * Gets the document fields of an entity to read a page token from.
+     *
+     * Sort fields are read from what the hydrator extracts or the entity
+     * serializes, so they
+     * don't need to be exposed by the entity.
+     *
+     * @param $entity - The entity
+     * @return - The document fields, including the ID
+     */
+    private function toTokenSource(T $entity): array<arraykey,mixed>
+    {
+        $document = [];
+        foreach ($this->toDocument($entity) as $k => $v) {
+            $document[$k] = $v;
+        }
+        if (!array_key_exists('_id', $document)) {
+            $document['_id'] = Getter::getId($entity);
+        }
+        return $document;
+    }
+
+    /**
+     * Possibly add the entity to the shared cache.
+     *
+     * The document version is stored alongside so a stale copy never replaces
+     * a newer one.
+     *
+     * @param $entity - The entity to possibly share
+     */
+    private function share(T $entity): void
+    {
+        if ($this->sharedCache !== null) {
+            $this->sharedCache->store(
+                (string) Getter::getId($entity),
+                (int) Getter::get($entity, 'version'),
+                \MongoDB\BSON\fromPHP($this->hydrator?->extract($entity) ?? $entity)
+            );
+        }
     }
 }
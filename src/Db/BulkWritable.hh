@@ -0,0 +1,59 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use MongoDB\BSON\Persistable;
+use MongoDB\Driver\WriteResult;
+
+/**
+ * Can write several pending changes to its collection in one bulk write.
+ *
+ * `AbstractMongoDao` doesn't implement this itself; a subclass which should
+ * take part in a `UnitOfWork` implements it by calling `doWriteBulk`.
+ *
+ * @since 0.8.0
+ */
+interface BulkWritable
+{
+    /**
+     * Writes inserts, updates, and deletes as a single bulk write.
+     *
+     * Publishing events are fired for each entity, with all `pre` events
+     * before the write and all `post` events after it, in the order given.
+     * Updates for entities which aren't dirty are skipped. Deletes can be
+     * given as identifiers, in which case the entities are loaded first, and
+     * those which don't exist are skipped.
+     *
+     * @param $inserts - The documents to insert
+     * @param $updates - The entities to update
+     * @param $deletes - The entities to delete, or their identifiers
+     * @param $ordered - Whether the operations must run in order
+     * @return - Whatever MongoDB returns, or `null` if there was nothing to do
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    public function writeBulk(
+        \ConstVector<Persistable> $inserts,
+        \ConstVector<Entity\Modifiable> $updates,
+        \ConstVector<mixed> $deletes,
+        bool $ordered = true,
+    ): ?WriteResult;
+}
@@ -0,0 +1,308 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use Psr\Log\LoggerInterface as Logger;
+
+/**
+ * Collects field increments in APC shared memory to write them in bulk.
+ *
+ * Increments are added to a counter per document and field, which lives in
+ * the current generation. A flush moves on to a new generation, then writes
+ * the counters of the older ones and subtracts what was written only once the
+ * write succeeded. If the write fails or the process dies, the counters stay
+ * and the next flush sends them again, so each increment is written at least
+ * once. Increments the server rejects are subtracted too, and logged, so
+ * they aren't retried forever. A generation is removed once a later flush
+ * finds all of its counters at zero; an increment which lands in a removed
+ * generation is moved to the current one.
+ *
+ * A flush is due after `$interval` seconds or `$threshold` increments since
+ * the last one. Only one process flushes at a time.
+ *
+ * APC is not durable: increments are lost if the cache is cleared or the
+ * server restarts before a flush.
+ *
+ * @since 0.8.0
+ */
+class CounterBuffer
+{
+    /**
+     * The logger for rejected increments
+     */
+    private Logger $logger;
+
+    /**
+     * Creates a new CounterBuffer.
+     *
+     * @param $namespace - The namespace, usually the collection name
+     * @param $interval - The number of seconds between flushes
+     * @param $threshold - The number of increments which make a flush due
+     * @param $prefix - The prefix for all APC keys
+     * @param $logger - The logger for rejected increments; will use `Psr\Log\NullLogger` by default
+     */
+    public function __construct(
+        private string $namespace,
+        private int $interval = 10,
+        private int $threshold = 1000,
+        private string $prefix = 'labrys',
+        ?Logger $logger = null,
+    ) {
+        $this->logger = $logger ?? new \Psr\Log\NullLogger();
+    }
+
+    /**
+     * Adds to a counter.
+     *
+     * @param $id - The document identifier
+     * @param $field - The field to increment
+     * @param $amount - The amount to add
+     * @return - Whether a flush is due
+     */
+    public function increment(string $id, string $field, int $amount = 1): bool
+    {
+        do {
+            $gen = $this->getGeneration();
+            $key = $this->counterKey($gen, $id, $field);
+            if (apc_inc($key, $amount) === false) {
+                if (apc_add($key, $amount)) {
+                    // the first increment registers the counter in its generation
+                    $slot = $this->add("$gen:n");
+                    apc_store($this->key("$gen:s$slot"), [$id, $field]);
+                } else {
+                    apc_inc($key, $amount);
+                }
+            }
+            // a stalled process may have written to a generation already swept
+            $swept = (int) apc_fetch($this->key('swept'));
+            $gone = $swept >= $gen;
+            if ($gone) {
+                apc_dec($key, $amount);
+                // the generation may have been evicted and seeded again too low
+                apc_cas($this->key('gen'), $gen, $swept + 1);
+            }
+        } while ($gone);
+        $hits = $this->add("$gen:hits");
+        return $hits >= $this->threshold ||
+            time() - (int) apc_fetch($this->key('flushed')) >= $this->interval;
+    }
+
+    /**
+     * Gets the amount not yet written for a counter.
+     *
+     * @param $id - The document identifier
+     * @param $field - The field
+     * @return - The pending amount
+     */
+    public function getPending(string $id, string $field): int
+    {
+        $keys = [];
+        $gen = $this->getGeneration();
+        for ($g = (int) apc_fetch($this->key('swept')) + 1; $g <= $gen; $g++) {
+            $keys[] = $this->counterKey($g, $id, $field);
+        }
+        $values = apc_fetch($keys);
+        return is_array($values) ? (int) array_sum($values) : 0;
+    }
+
+    /**
+     * Writes the pending counters.
+     *
+     * `$write` is called once per generation with pending counters, and
+     * returns the positions of any it couldn't write because the server
+     * rejected them. Those are logged and dropped. If `$write` throws, the
+     * counters are kept for the next flush and the exception is rethrown.
+     *
+     * @param $write - Writes the increments, returns the positions rejected
+     * @return - The number of counters written, or 0 if another process is flushing
+     */
+    public function flush((function(ImmVector<CounterDelta>): ImmSet<int>) $write): int
+    {
+        $lock = $this->key('lock');
+        if (!apc_add($lock, getmypid(), max(60, $this->interval * 2))) {
+            return 0;
+        }
+        try {
+            $this->getGeneration();
+            $current = $this->add('gen');
+            apc_store($this->key('flushed'), time());
+            $swept = (int) apc_fetch($this->key('swept'));
+            $sweeping = true;
+            $sent = 0;
+            for ($gen = $swept + 1; $gen < $current; $gen++) {
+                $counters = $this->read($gen);
+                $pending = $counters->filter($a ==> $a['amount'] !== 0);
+                if (!$pending->isEmpty()) {
+                    $keys = $pending->keys();
+                    $deltas = $pending->values()->toImmVector();
+                    $rejected = $write($deltas);
+                    foreach ($deltas as $i => $delta) {
+                        apc_dec($keys[$i], $delta['amount']);
+                        if ($rejected->contains($i)) {
+                            $this->logger->warning(
+                                "Dropped increment of {field} by {amount} for {id} in {namespace}",
+                                [
+                                    'namespace' => $this->namespace,
+                                    'id' => $delta['id'],
+                                    'field' => $delta['field'],
+                                    'amount' => $delta['amount'],
+                                ]
+                            );
+                        }
+                    }
+                    $sent += $deltas->count() - $rejected->count();
+                    $sweeping = false;
+                } elseif ($sweeping && $gen < $current - 1 && $this->sweep($gen, $counters->keys())) {
+                    $swept = $gen;
+                } else {
+                    $sweeping = false;
+                }
+            }
+            return $sent;
+        } finally {
+            apc_delete($lock);
+        }
+    }
+
+    /**
+     * Reads the counters of a generation.
+     *
+     * @param $gen - The generation
+     * @return - The counters, by APC key
+     */
+    private function read(int $gen): Map<string,CounterDelta>
+    {
+        $counters = Map{};
+        $count = (int) apc_fetch($this->key("$gen:n"));
+        if ($count === 0) {
+            return $counters;
+        }
+        $slots = apc_fetch(array_map($i ==> $this->key("$gen:s$i"), range(1, $count)));
+        if (!is_array($slots)) {
+            return $counters;
+        }
+        $names = Map{};
+        foreach ($slots as $slot) {
+            list($id, $field) = $slot;
+            $names[$this->counterKey($gen, (string) $id, (string) $field)] = tuple((string) $id, (string) $field);
+        }
+        $values = apc_fetch($names->keys()->toArray());
+        foreach ($names as $key => $name) {
+            $counters[$key] = shape(
+                'id' => $name[0],
+                'field' => $name[1],
+                'amount' => is_array($values) ? (int) ($values[$key] ?? 0) : 0,
+            );
+        }
+        return $counters;
+    }
+
+    /**
+     * Removes the keys of a generation whose counters are all zero.
+     *
+     * The generation is marked swept before it's checked again, so a process
+     * which increments it from then on moves its increment elsewhere. If a
+     * counter changed in the meantime, the mark is taken back.
+     *
+     * @param $gen - The generation
+     * @param $counters - The APC keys of its counters
+     * @return - Whether the generation was removed
+     */
+    private function sweep(int $gen, \ConstVector<string> $counters): bool
+    {
+        apc_store($this->key('swept'), $gen);
+        $values = $counters->isEmpty() ? [] : apc_fetch($counters->toArray());
+        foreach ((array) $values as $value) {
+            if ((int) $value !== 0) {
+                apc_store($this->key('swept'), $gen - 1);
+                return false;
+            }
+        }
+        $count = (int) apc_fetch($this->key("$gen:n"));
+        $keys = $counters->toArray();
+        for ($i = 1; $i <= $count; $i++) {
+            $keys[] = $this->key("$gen:s$i");
+        }
+        $keys[] = $this->key("$gen:n");
+        $keys[] = $this->key("$gen:hits");
+        apc_delete($keys);
+        return true;
+    }
+
+    /**
+     * Gets the current generation.
+     *
+     * If APC evicted it, it starts again after the last one swept.
+     *
+     * @return - The generation
+     */
+    private function getGeneration(): int
+    {
+        $gen = apc_fetch($this->key('gen'));
+        if ($gen === false) {
+            apc_add($this->key('gen'), (int) apc_fetch($this->key('swept')) + 1);
+            $gen = apc_fetch($this->key('gen'));
+        }
+        return (int) $gen;
+    }
+
+    /**
+     * Atomically adds one to a number, creating it if needed.
+     *
+     * @param $name - The key name
+     * @return - The new number
+     */
+    private function add(string $name): int
+    {
+        $key = $this->key($name);
+        $value = apc_inc($key);
+        if ($value === false) {
+            $value = apc_add($key, 1) ? 1 : apc_inc($key);
+        }
+        return (int) $value;
+    }
+
+    /**
+     * Gets the APC key of a counter.
+     *
+     * The identifier and field are hex encoded so neither can contain the
+     * key separator.
+     *
+     * @param $gen - The generation
+     * @param $id - The document identifier
+     * @param $field - The field
+     * @return - The APC key
+     */
+    private function counterKey(int $gen, string $id, string $field): string
+    {
+        return $this->key("$gen:c:" . bin2hex($id) . ':' . bin2hex($field));
+    }
+
+    /**
+     * Gets an APC key.
+     *
+     * @param $name - The key name
+     * @return - The APC key
+     */
+    private function key(string $name): string
+    {
+        return "{$this->prefix}:counter:{$this->namespace}:$name";
+    }
+}
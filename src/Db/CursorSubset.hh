@@ -24,7 +24,8 @@ namespace Labrys\Db;
  */
 class CursorSubset<T> extends \IteratorIterator<T> implements \JsonSerializable
 {
-    private int $total;
+    private ?int $total;
+    private ?(function(): int) $counter;
 
     /**
      * Create a new CursorSubset.
@@ -42,13 +43,41 @@ class CursorSubset<T> extends \IteratorIterator<T> implements \JsonSerializable
         $this->total = $total;
     }
 
+    /**
+     * Create a new CursorSubset whose total is counted on first use.
+     *
+     * @param $iterable - The traversable to wrap
+     * @param $counter - Function which returns the total number of items in
+     *        the superset
+     * @return - The new CursorSubset
+     * @since 0.8.0
+     */
+    public static function deferred(\Traversable<T> $iterable, (function(): int) $counter): CursorSubset<T>
+    {
+        $subset = new CursorSubset($iterable, 0);
+        $subset->total = null;
+        $subset->counter = $counter;
+        return $subset;
+    }
+
     /**
      * Gets the superset total.
      *
      * @return - The total number of items in the superset (never negative).
+     * @throws \RangeException if a deferred total is negative
      */
     public function getTotal(): int
     {
+        if ($this->total === null) {
+            $counter = $this->counter;
+            invariant($counter !== null, 'A deferred total has a counter');
+            $total = $counter();
+            if ($total < 0) {
+                throw new \RangeException("Total cannot be a negative number");
+            }
+            $this->total = $total;
+            $this->counter = null;
+        }
         return $this->total;
     }
 
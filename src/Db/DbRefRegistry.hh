@@ -0,0 +1,166 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use Labrys\Getter;
+
+/**
+ * Resolves DbRefs pointing at any number of collections.
+ *
+ * References are grouped by `$ref` and each group is resolved with one call
+ * to the matching `DbRefResolver`. Groups for `AbstractMongoDao` resolvers are
+ * loaded concurrently using `genAll`, so identifiers requested elsewhere in the
+ * same scheduler tick share the query.
+ *
+ * @since 0.8.0
+ */
+class DbRefRegistry
+{
+    /**
+     * The resolvers
+     */
+    private ImmVector<DbRefResolver<mixed>> $resolvers;
+    /**
+     * The resolver for each reference type seen so far
+     */
+    private Map<string,?DbRefResolver<mixed>> $byRef = Map{};
+
+    /**
+     * Creates a new DbRefRegistry.
+     *
+     * @param $resolvers - The resolvers
+     */
+    public function __construct(Traversable<DbRefResolver<mixed>> $resolvers)
+    {
+        $this->resolvers = new ImmVector($resolvers);
+    }
+
+    /**
+     * Gets the resolver for a reference type.
+     *
+     * @param $ref - The reference type (usually a MongoDB collection name)
+     * @return - The first resolver which supports the type, or `null`
+     */
+    public function getResolver(string $ref): ?DbRefResolver<mixed>
+    {
+        if (!$this->byRef->containsKey($ref)) {
+            $this->byRef[$ref] = $this->resolvers->filter($a ==> $a->isResolvable($ref))->firstValue();
+        }
+        return $this->byRef[$ref];
+    }
+
+    /**
+     * Resolves a MongoDB DbRef.
+     *
+     * @param $ref - The DbRef to load
+     * @return - The loaded entity or `null` if not found
+     * @throws \InvalidArgumentException If `$ref` is of an unsupported type
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be retrieved
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    public function resolve(DbRef $ref): mixed
+    {
+        return $this->getResolverOrFail($ref['$ref'])->resolve($ref);
+    }
+
+    /**
+     * Resolves several MongoDB DbRefs of any type.
+     *
+     * @param $refs - The DbRefs to load
+     * @return - The loaded entities in the same order as `$refs`, with `null`
+     *         for any which weren't found
+     * @throws \InvalidArgumentException If any `$ref`s are of an unsupported type
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be retrieved
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    public function resolveAll(Traversable<DbRef> $refs): ImmVector<mixed>
+    {
+        return \HH\Asio\join($this->genResolveAll($refs));
+    }
+
+    /**
+     * Asynchronously resolves several MongoDB DbRefs of any type.
+     *
+     * @param $refs - The DbRefs to load
+     * @return - The loaded entities in the same order as `$refs`, with `null`
+     *         for any which weren't found
+     * @throws \InvalidArgumentException If any `$ref`s are of an unsupported type
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be retrieved
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    public async function genResolveAll(Traversable<DbRef> $refs): Awaitable<ImmVector<mixed>>
+    {
+        $refs = new ImmVector($refs);
+        $groups = Map{};
+        foreach ($refs as $ref) {
+            $type = $ref['$ref'];
+            if (!$groups->containsKey($type)) {
+                $this->getResolverOrFail($type);
+                $groups[$type] = Vector{};
+            }
+            $groups[$type][] = $ref;
+        }
+        $loaded = await \HH\Asio\m(
+            $groups->mapWithKey(($type, $group) ==> $this->genGroup($type, $group))
+        );
+        return $refs->map($ref ==> $loaded[$ref['$ref']][(string) $ref['$id']] ?? null);
+    }
+
+    /**
+     * Loads all references of one type.
+     *
+     * @param $type - The reference type
+     * @param $refs - The DbRefs to load
+     * @return - The entities found, keyed by identifier
+     */
+    private async function genGroup(string $type, \ConstVector<DbRef> $refs): Awaitable<ImmMap<string,mixed>>
+    {
+        $resolver = $this->getResolverOrFail($type);
+        if ($resolver instanceof AbstractMongoDao) {
+            $entities = await $resolver->genAll($refs->map($a ==> $a['$id']));
+        } else {
+            $entities = $resolver->resolveAll($refs);
+        }
+        $found = Map{};
+        foreach ($entities as $entity) {
+            $found[(string) Getter::getId($entity)] = $entity;
+        }
+        return $found->toImmMap();
+    }
+
+    /**
+     * Gets the resolver for a reference type, or complains.
+     *
+     * @param $ref - The reference type
+     * @return - The resolver
+     * @throws \InvalidArgumentException If the type is unsupported
+     */
+    private function getResolverOrFail(string $ref): DbRefResolver<mixed>
+    {
+        $resolver = $this->getResolver($ref);
+        if ($resolver === null) {
+            throw new \InvalidArgumentException("Unsupported reference type: $ref");
+        }
+        return $resolver;
+    }
+}
@@ -22,6 +22,13 @@ namespace Labrys\Db\Entity;
 /**
  * A trait for entities which can track changes.
  *
+ * Changes are kept as one operation per field path and compacted as they are
+ * recorded: a `$set` or `$unset` supersedes earlier changes to the field and
+ * its children, `$inc` deltas are summed, `$push` values are merged into one
+ * `$each` list, and operations following a `$set` are folded into its value
+ * where possible. Operations which can't be combined with an earlier change to
+ * the same field throw a `LogicException` right away.
+ *
  * @since 0.5.1
  */
 trait Tracking
@@ -29,9 +36,9 @@ trait Tracking
     require implements Modifiable;
 
     /**
-     * Changes to persist.
+     * Changes to persist, as an operator and value keyed by field path.
      */
-    protected Map<string,Map<string,mixed>> $changes = Map{};
+    protected Map<string,(string,mixed)> $changes = Map{};
 
     /**
      * Gets the pending changes.
@@ -40,7 +47,15 @@ trait Tracking
      */
     public function getChanges(): \ConstMap<string,Map<string,mixed>>
     {
-        return $this->changes;
+        $ops = Map{};
+        foreach ($this->changes as $field => $change) {
+            list($op, $value) = $change;
+            if (!$ops->containsKey($op)) {
+                $ops[$op] = Map{};
+            }
+            $ops[$op][$field] = $value;
+        }
+        return $ops;
     }
 
     /**
@@ -62,11 +77,7 @@ trait Tracking
      */
     protected function fieldSet(string $field, mixed $value): this
     {
-        if (!$this->changes->containsKey('$set')) {
-            $this->changes['$set'] = Map{};
-        }
-        $this->changes['$set'][$field] = $value;
-        return $this;
+        return $this->fieldChange('$set', $field, $value);
     }
 
     /**
@@ -77,11 +88,7 @@ trait Tracking
      */
     protected function fieldUnset(string $field): this
     {
-        if (!$this->changes->containsKey('$unset')) {
-            $this->changes['$unset'] = Map{};
-        }
-        $this->changes['$unset'][$field] = '';
-        return $this;
+        return $this->fieldChange('$unset', $field, '');
     }
 
     /**
@@ -93,11 +100,7 @@ trait Tracking
      */
     protected function fieldIncrement(string $field, int $value = 1): this
     {
-        if (!$this->changes->containsKey('$inc')) {
-            $this->changes['$inc'] = Map{};
-        }
-        $this->changes['$inc'][$field] = $value;
-        return $this;
+        return $this->fieldChange('$inc', $field, $value);
     }
 
     /**
@@ -108,11 +111,7 @@ trait Tracking
      */
     protected function fieldNow(string $field): this
     {
-        if (!$this->changes->containsKey('$currentDate')) {
-            $this->changes['$currentDate'] = Map{};
-        }
-        $this->changes['$currentDate'][$field] = true;
-        return $this;
+        return $this->fieldChange('$currentDate', $field, true);
     }
 
     /**
@@ -124,11 +123,7 @@ trait Tracking
      */
     protected function fieldPush(string $field, mixed $value): this
     {
-        if (!$this->changes->containsKey('$push')) {
-            $this->changes['$push'] = Map{};
-        }
-        $this->changes['$push'][$field] = $value;
-        return $this;
+        return $this->fieldChange('$push', $field, $value);
     }
 
     /**
@@ -140,11 +135,7 @@ trait Tracking
      */
     protected function fieldPushAll(string $field, \ConstVector<mixed> $value): this
     {
-        if (!$this->changes->containsKey('$push')) {
-            $this->changes['$push'] = Map{};
-        }
-        $this->changes['$push'][$field] = ['$each' => $value->toArray()];
-        return $this;
+        return $this->fieldChange('$push', $field, ['$each' => $value->toArray()]);
     }
 
     /**
@@ -162,11 +153,7 @@ trait Tracking
      */
     protected function fieldPull(string $field, mixed $value): this
     {
-        if (!$this->changes->containsKey('$pull')) {
-            $this->changes['$pull'] = Map{};
-        }
-        $this->changes['$pull'][$field] = $value;
-        return $this;
+        return $this->fieldChange('$pull', $field, $value);
     }
 
     /**
@@ -179,13 +166,102 @@ trait Tracking
     protected function aggregateChanges(Modifiable $child, string $field): this
     {
         foreach ($child->getChanges() as $op => $sets) {
-            if (!$this->changes->containsKey($op)) {
-                $this->changes[$op] = Map{};
-            }
             foreach ($sets as $k => $v) {
-                $this->changes[$op]["$field.$k"] = $v;
+                $this->fieldChange($op, "$field.$k", $v);
             }
         }
         return $this;
     }
+
+    /**
+     * Records a change, combining it with any earlier change to the field.
+     *
+     * @param $op - The update operator
+     * @param $field - The field path
+     * @param $value - The operator value
+     * @return - provides a fluent interface
+     * @throws \LogicException if the change can't be combined with an earlier one
+     */
+    protected function fieldChange(string $op, string $field, mixed $value): this
+    {
+        $old = $this->changes[$field] ?? null;
+        if ($op === '$set' || $op === '$unset' || $op === '$currentDate') {
+            // replacing a value makes any changes to its children pointless
+            $prefix = "$field.";
+            $length = strlen($prefix);
+            foreach ($this->changes->keys() as $k) {
+                if (strncmp($k, $prefix, $length) === 0) {
+                    $this->changes->removeKey($k);
+                }
+            }
+        } elseif ($old !== null) {
+            list($oldOp, $oldValue) = $old;
+            if ($oldOp === '$set' && is_array($oldValue) && $op === '$push' && self::isPlainPush($value)) {
+                $value = array_merge($oldValue, self::pushValues($value));
+                $op = '$set';
+            } elseif ($oldOp === '$set' && is_array($oldValue) && $op === '$pull' && is_scalar($value) &&
+                array_filter($oldValue, $a ==> $a !== null && !is_scalar($a)) === []) {
+                // conditions and objects can only be matched by the server
+                $value = array_values(array_filter($oldValue, $a ==> !self::isSameScalar($a, $value)));
+                $op = '$set';
+            } elseif ($op === '$inc' && ($oldOp === '$inc' || $oldOp === '$set') && is_numeric($oldValue)) {
+                $value = $oldValue + $value;
+                $op = $oldOp;
+            } elseif ($op === '$inc' && $oldOp === '$unset') {
+                $op = '$set';
+            } elseif ($op === '$push' && $oldOp === '$push' && self::isPlainPush($oldValue) && self::isPlainPush($value)) {
+                $value = ['$each' => array_merge(self::pushValues($oldValue), self::pushValues($value))];
+            } elseif ($op === '$pull' && $oldOp === '$pull' && !is_array($value) &&
+                (!is_array($oldValue) || array_keys($oldValue) === ['$in'])) {
+                $values = is_array($oldValue) ? $oldValue['$in'] : [$oldValue];
+                $values[] = $value;
+                $value = ['$in' => $values];
+            } else {
+                throw new \LogicException("Cannot combine $op with $oldOp for field: $field");
+            }
+        }
+        $this->changes[$field] = tuple($op, $value);
+        return $this;
+    }
+
+    /**
+     * Whether two scalars are equal the way MongoDB compares them.
+     *
+     * Numbers are equal across types, so `2` matches `2.0`, but not strings
+     * or booleans.
+     *
+     * @param $a - The first value
+     * @param $b - The second value
+     * @return - Whether they're equal
+     */
+    private static function isSameScalar(mixed $a, mixed $b): bool
+    {
+        if ((is_int($a) || is_float($a)) && (is_int($b) || is_float($b))) {
+            return $a == $b;
+        }
+        return $a === $b;
+    }
+
+    /**
+     * Whether a `$push` value has no modifiers other than `$each`.
+     *
+     * @param $value - Either a single value or an `$each` modifier
+     * @return - Whether the values can be merged with another push
+     */
+    private static function isPlainPush(mixed $value): bool
+    {
+        return !is_array($value) || !array_key_exists('$each', $value) || count($value) === 1;
+    }
+
+    /**
+     * Gets the values of a `$push` operation.
+     *
+     * @param $value - Either a single value or an `$each` modifier
+     * @return - The values to push
+     */
+    private static function pushValues(mixed $value): array<mixed>
+    {
+        return is_array($value) && array_key_exists('$each', $value) ?
+            (array) $value['$each'] : [$value];
+    }
 }
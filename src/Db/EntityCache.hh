@@ -0,0 +1,79 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * A first-level cache for entities keyed by identifier.
+ *
+ * @since 0.8.0
+ */
+interface EntityCache<T>
+{
+    /**
+     * Gets an entity from the cache, counting a hit or a miss.
+     *
+     * @param $id - The cache key
+     * @return - The entity found or `null`
+     */
+    public function get(string $id): ?T;
+
+    /**
+     * Whether the cache holds an entity, without affecting statistics.
+     *
+     * @param $id - The cache key
+     * @return - Whether the key is present
+     */
+    public function contains(string $id): bool;
+
+    /**
+     * Adds an entity to the cache if it isn't already there.
+     *
+     * @param $id - The cache key
+     * @param $entity - The entity to store
+     */
+    public function add(string $id, T $entity): void;
+
+    /**
+     * Stores an entity in the cache, replacing any existing entry.
+     *
+     * @param $id - The cache key
+     * @param $entity - The entity to store
+     */
+    public function set(string $id, T $entity): void;
+
+    /**
+     * Removes an entity from the cache.
+     *
+     * @param $id - The cache key
+     */
+    public function remove(string $id): void;
+
+    /**
+     * Removes all entities from the cache.
+     */
+    public function clear(): void;
+
+    /**
+     * Gets the cache statistics.
+     *
+     * @return - The hit, miss, and eviction counters along with the size
+     */
+    public function getStats(): CacheStats;
+}
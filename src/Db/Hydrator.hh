@@ -0,0 +1,46 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * Converts between BSON documents (as arrays) and entities.
+ *
+ * Implementations are usually created by `Labrys\Db\HydratorGenerator`.
+ *
+ * @since 0.8.0
+ */
+interface Hydrator<T>
+{
+    /**
+     * Creates an entity from a document.
+     *
+     * @param $document - The document
+     * @return - The entity, with no pending changes
+     */
+    public function hydrate(array<string,mixed> $document): T;
+
+    /**
+     * Creates a document from an entity.
+     *
+     * @param $entity - The entity
+     * @return - The document
+     */
+    public function extract(T $entity): array<string,mixed>;
+}
@@ -0,0 +1,216 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * Generates specialized `Hydrator` classes for entities.
+ *
+ * Each instance property of the entity maps to the document field of the same
+ * name, except:
+ * * With the `Entity\Identified` trait, the `id` property maps to `_id`
+ * * With the `Entity\Tracking` trait, the `changes` property isn't stored,
+ *   and is emptied when hydrating
+ *
+ * Hydrated entities are created without calling their constructor. Fields
+ * missing from a document leave the property at its default value.
+ *
+ * Values are converted the way a `bsonUnserialize` usually would, based on
+ * the type hint of the property:
+ * * `Map`, `ImmMap`, `Vector`, `ImmVector`, `Set`, and `ImmSet` are built from
+ *   BSON documents and arrays, and stored as arrays
+ * * `DateTimeImmutable`, `DateTime`, and `DateTimeInterface` are built from
+ *   `UTCDateTime`, and stored as one
+ *
+ * Other properties get the BSON value as is. An entity whose
+ * `bsonUnserialize` does anything else needs a hand-written hydrator.
+ *
+ * @since 0.8.0
+ */
+class HydratorGenerator
+{
+    /**
+     * Generates the source code of a hydrator.
+     *
+     * @param $entityClass - The entity class name
+     * @param $hydratorClass - The fully qualified name of the class to generate
+     * @return - The Hack source code
+     * @throws \ReflectionException if the entity class doesn't exist
+     */
+    public function generate(string $entityClass, string $hydratorClass): string
+    {
+        $rc = new \ReflectionClass($entityClass);
+        $entity = '\\' . $rc->getName();
+        $pos = strrpos($hydratorClass, '\\');
+        $namespace = $pos === false ? '' : substr($hydratorClass, 0, $pos);
+        $shortName = $pos === false ? $hydratorClass : substr($hydratorClass, $pos + 1);
+        $tracking = $this->usesTrait($rc, Entity\Tracking::class);
+
+        $hydrate = [];
+        $extract = [];
+        foreach ($this->getFields($rc) as $property => $field) {
+            $f = var_export($field, true);
+            $type = $this->getTypeName($rc->getProperty($property));
+            $hydrate[] = "            if (array_key_exists($f, \$d)) {\n" .
+                "                \$v = \$d[$f];\n" .
+                "                \$o->$property = " . $this->toProperty($type, '$v') . ";\n" .
+                "            }";
+            $extract[] = "                $f => " . $this->toField($type, "\$o->$property") . ",";
+        }
+        if ($tracking) {
+            $hydrate[] = "            \$o->changes = Map{};";
+        }
+
+        $code = "<?hh\n// Generated by Labrys\\Db\\HydratorGenerator. Do not edit.\n";
+        if ($namespace !== '') {
+            $code .= "namespace $namespace;\n";
+        }
+        $code .= "\n/**\n * Hydrator for `$entity`.\n */\n" .
+            "final class $shortName implements \\Labrys\\Db\\Hydrator<$entity>\n{\n" .
+            "    private (function(array<string,mixed>): $entity) \$hydrator;\n" .
+            "    private (function($entity): array<string,mixed>) \$extractor;\n\n" .
+            "    public function __construct()\n    {\n" .
+            "        \$prototype = (new \\ReflectionClass($entity::class))->newInstanceWithoutConstructor();\n" .
+            "        \$this->hydrator = \\Closure::bind(function (array \$d) use (\$prototype) {\n" .
+            "            \$o = clone \$prototype;\n" .
+            implode("\n", $hydrate) . "\n" .
+            "            return \$o;\n" .
+            "        }, null, $entity::class);\n" .
+            "        \$this->extractor = \\Closure::bind(function (\$o) {\n" .
+            "            return [\n" .
+            implode("\n", $extract) . "\n" .
+            "            ];\n" .
+            "        }, null, $entity::class);\n" .
+            "    }\n\n" .
+            "    public function hydrate(array<string,mixed> \$document): $entity\n    {\n" .
+            "        \$h = \$this->hydrator;\n        return \$h(\$document);\n    }\n\n" .
+            "    public function extract($entity \$entity): array<string,mixed>\n    {\n" .
+            "        \$e = \$this->extractor;\n        return \$e(\$entity);\n    }\n" .
+            "}\n";
+        return $code;
+    }
+
+    /**
+     * Gets the document field name for each property.
+     *
+     * @param $rc - The entity class
+     * @return - The field names keyed by property name
+     */
+    protected function getFields(\ReflectionClass $rc): ImmMap<string,string>
+    {
+        $identified = $this->usesTrait($rc, Entity\Identified::class);
+        $tracking = $this->usesTrait($rc, Entity\Tracking::class);
+        $fields = Map{};
+        foreach ($rc->getProperties() as $rp) {
+            $name = $rp->getName();
+            if ($rp->isStatic() || ($tracking && $name === 'changes')) {
+                continue;
+            }
+            $fields[$name] = $identified && $name === 'id' ? '_id' : $name;
+        }
+        return $fields->toImmMap();
+    }
+
+    /**
+     * Gets the class name from the type hint of a property.
+     *
+     * @param $rp - The property
+     * @return - The class name without namespace or generics, or `''`
+     */
+    private function getTypeName(\ReflectionProperty $rp): string
+    {
+        $type = ltrim((string) $rp->getTypeText(), '?@\\');
+        $pos = strpos($type, '<');
+        if ($pos !== false) {
+            $type = substr($type, 0, $pos);
+        }
+        return strpos($type, 'HH\\') === 0 ? substr($type, 3) : $type;
+    }
+
+    /**
+     * Gets the expression which converts a BSON value for a property.
+     *
+     * @param $type - The class name of the property type
+     * @param $value - The expression for the BSON value
+     * @return - The converting expression
+     */
+    private function toProperty(string $type, string $value): string
+    {
+        switch ($type) {
+            case 'Map':
+            case 'ImmMap':
+            case 'Vector':
+            case 'ImmVector':
+            case 'Set':
+            case 'ImmSet':
+                return "$value === null ? null : new \\HH\\$type($value instanceof \\Traversable ? $value : (array) $value)";
+            case 'DateTimeImmutable':
+            case 'DateTimeInterface':
+                return "$value instanceof \\MongoDB\\BSON\\UTCDateTime ? \\DateTimeImmutable::createFromMutable({$value}->toDateTime()) : $value";
+            case 'DateTime':
+                return "$value instanceof \\MongoDB\\BSON\\UTCDateTime ? {$value}->toDateTime() : $value";
+        }
+        return $value;
+    }
+
+    /**
+     * Gets the expression which converts a property for BSON.
+     *
+     * @param $type - The class name of the property type
+     * @param $value - The expression for the property
+     * @return - The converting expression
+     */
+    private function toField(string $type, string $value): string
+    {
+        switch ($type) {
+            case 'Map':
+            case 'ImmMap':
+                return "{$value}?->toArray()";
+            case 'Vector':
+            case 'ImmVector':
+            case 'Set':
+            case 'ImmSet':
+                return "{$value}?->toValuesArray()";
+            case 'DateTimeImmutable':
+            case 'DateTimeInterface':
+            case 'DateTime':
+                return "$value instanceof \\DateTimeInterface ? new \\MongoDB\\BSON\\UTCDateTime(" .
+                    "{$value}->getTimestamp() * 1000 + intdiv((int) {$value}->format('u'), 1000)) : $value";
+        }
+        return $value;
+    }
+
+    /**
+     * Whether a class or any of its parents use a trait.
+     *
+     * @param $rc - The class
+     * @param $trait - The trait name
+     * @return - Whether the trait is used
+     */
+    private function usesTrait(\ReflectionClass $rc, string $trait): bool
+    {
+        do {
+            if (in_array($trait, $rc->getTraitNames(), true)) {
+                return true;
+            }
+            $rc = $rc->getParentClass();
+        } while ($rc);
+        return false;
+    }
+}
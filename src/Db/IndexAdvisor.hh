@@ -0,0 +1,322 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use Psr\Log\LoggerInterface as Logger;
+
+/**
+ * Checks queries against the indexes declared for a collection.
+ *
+ * This is meant for development and staging. It follows the same rules the
+ * query planner does, without asking the server:
+ *
+ * * Criteria can use an index if one of their fields is its first key, or if
+ *   each branch of an `$or` can use one. Otherwise the query needs a
+ *   collection scan (`COLLSCAN`), unless an index provides its sort order.
+ * * A sort can use an index if its fields follow, in order, any leading index
+ *   keys matched by equality in the criteria. The directions must all match
+ *   the index or all be reversed. Otherwise the query needs an in-memory
+ *   sort (`SORT`). An `$in` with several values isn't equality here, since
+ *   the index returns the documents for each value in turn.
+ *
+ * The `_id` index is always assumed. Each finding is logged as a warning, or
+ * thrown as a `Labrys\Db\Exception\Unindexed`, along with the call site.
+ *
+ * ```hack
+ * $advisor = new IndexAdvisor($indexes, IndexAdvisor::MODE_FAIL);
+ * $dao = new MyDao($manager, 'db.coll', Map{'indexAdvisor' => $advisor});
+ * ```
+ *
+ * @since 0.8.0
+ */
+class IndexAdvisor
+{
+    /**
+     * Findings are logged
+     */
+    const string MODE_REPORT = 'report';
+    /**
+     * Findings are thrown
+     */
+    const string MODE_FAIL = 'fail';
+
+    /**
+     * The keys of each index, in order
+     */
+    private ImmVector<ImmVector<(string,mixed)>> $indexes;
+    /**
+     * The findings so far
+     */
+    private Vector<IndexFinding> $findings = Vector{};
+
+    /**
+     * Creates a new IndexAdvisor.
+     *
+     * @param $indexes - The indexes declared for the collection
+     * @param $mode - Either `report` or `fail`
+     * @param $logger - The logger for findings; will use `Psr\Log\NullLogger` by default
+     * @throws \InvalidArgumentException if the mode is unknown
+     */
+    public function __construct(
+        Traversable<MongoIndex> $indexes,
+        private string $mode = self::MODE_REPORT,
+        private ?Logger $logger = null,
+    ) {
+        if ($mode !== self::MODE_REPORT && $mode !== self::MODE_FAIL) {
+            throw new \InvalidArgumentException("Unknown index advisor mode: $mode");
+        }
+        $this->logger = $logger ?? new \Psr\Log\NullLogger();
+        $all = Vector{ImmVector{tuple('_id', 1)}};
+        foreach ($indexes as $index) {
+            $keys = Vector{};
+            foreach ($index->getKeys() as $field => $dir) {
+                $keys[] = tuple($field, $dir);
+            }
+            $all[] = $keys->toImmVector();
+        }
+        $this->indexes = $all->toImmVector();
+    }
+
+    /**
+     * Checks a query, and reports or fails for each finding.
+     *
+     * @param $collection - The collection name
+     * @param $criteria - Field to value pairs
+     * @param $pagination - Optional pagination parameters, for the sort order
+     * @throws Exception\Unindexed if a finding is made in `fail` mode
+     */
+    public function check(string $collection, \ConstMap<string,mixed> $criteria, ?\Caridea\Http\Pagination $pagination = null): void
+    {
+        $sort = $pagination?->getOrder() ?? ImmMap{};
+        $stages = $this->advise($criteria->toArray(), $sort);
+        if ($stages->isEmpty()) {
+            return;
+        }
+        $callSite = self::getCallSite();
+        foreach ($stages as $stage) {
+            $finding = shape(
+                'collection' => $collection,
+                'stage' => $stage,
+                'shape' => json_encode(Profiler::shapeOf($criteria)),
+                'sort' => json_encode($sort),
+                'callSite' => $callSite,
+            );
+            $this->findings[] = $finding;
+            $message = "Query on {$collection} needs {$stage}: " .
+                "{$finding['shape']} sorted by {$finding['sort']} at {$callSite}";
+            if ($this->mode === self::MODE_FAIL) {
+                throw new Exception\Unindexed($message);
+            }
+            /* HH_IGNORE_ERROR[4064]: This isn't null, we set it in the constructor */
+            $this->logger->warning($message, $finding);
+        }
+    }
+
+    /**
+     * Determines which expensive stages a query would need.
+     *
+     * @param $criteria - Field to value pairs
+     * @param $sort - Field names to sort direction, `true` for ascending
+     * @return - Any of `COLLSCAN` and `SORT`
+     */
+    public function advise(array<string,mixed> $criteria, \ConstMap<string,bool> $sort): ImmVector<string>
+    {
+        $stages = Vector{};
+        $sorted = $sort->isEmpty() || $this->canSort($criteria, $sort);
+        if (!$sorted) {
+            $stages[] = 'SORT';
+        }
+        if (count($criteria) > 0 && !$this->canFilter($criteria) &&
+            ($sort->isEmpty() || !$sorted)) {
+            $stages[] = 'COLLSCAN';
+        }
+        return $stages->toImmVector();
+    }
+
+    /**
+     * Gets the findings so far.
+     *
+     * @return - The findings, in order
+     */
+    public function getFindings(): ImmVector<IndexFinding>
+    {
+        return $this->findings->toImmVector();
+    }
+
+    /**
+     * Whether some index can narrow the criteria.
+     *
+     * @param $criteria - Field to value pairs
+     * @return - Whether an index applies
+     */
+    private function canFilter(array<string,mixed> $criteria): bool
+    {
+        list($equality, $range) = self::getFields($criteria);
+        foreach ($this->indexes as $keys) {
+            $first = $keys[0][0];
+            if ($equality->contains($first) || $range->contains($first)) {
+                return true;
+            }
+        }
+        $ors = $criteria['$or'] ?? null;
+        if (is_array($ors) && count($ors) > 0) {
+            foreach ($ors as $branch) {
+                if (!$this->canFilter((array) $branch)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Whether some index returns documents in the sort order.
+     *
+     * @param $criteria - Field to value pairs
+     * @param $sort - Field names to sort direction, `true` for ascending
+     * @return - Whether an index applies
+     */
+    private function canSort(array<string,mixed> $criteria, \ConstMap<string,bool> $sort): bool
+    {
+        $equality = self::getFields($criteria)[0];
+        foreach ($this->indexes as $keys) {
+            if (self::sortsBy($keys, $equality, $sort)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Whether an index returns documents in the sort order.
+     *
+     * @param $keys - The index keys
+     * @param $equality - The fields matched by equality in the criteria
+     * @param $sort - Field names to sort direction, `true` for ascending
+     * @return - Whether the index applies
+     */
+    private static function sortsBy(ImmVector<(string,mixed)> $keys, Set<string> $equality, \ConstMap<string,bool> $sort): bool
+    {
+        $i = 0;
+        // leading keys matched by equality don't affect the order
+        while ($i < $keys->count() && $equality->contains($keys[$i][0]) &&
+            !$sort->containsKey($keys[$i][0])) {
+            $i++;
+        }
+        if ($keys->count() - $i < $sort->count()) {
+            return false;
+        }
+        $sign = 0;
+        foreach ($sort as $field => $asc) {
+            list($key, $dir) = $keys[$i++];
+            if ($key !== $field || !is_numeric($dir) || (int) $dir === 0) {
+                return false;
+            }
+            $s = ((int) $dir > 0) === $asc ? 1 : -1;
+            if ($sign !== 0 && $s !== $sign) {
+                return false;
+            }
+            $sign = $s;
+        }
+        return true;
+    }
+
+    /**
+     * Splits the fields in criteria into those matched by equality and those
+     * matched by range or other operators.
+     *
+     * @param $criteria - Field to value pairs
+     * @return - The equality fields and the range fields
+     */
+    private static function getFields(array<string,mixed> $criteria): (Set<string>, Set<string>)
+    {
+        $equality = Set{};
+        $range = Set{};
+        foreach ($criteria as $field => $value) {
+            $field = (string) $field;
+            if ($field === '$and' && is_array($value)) {
+                foreach ($value as $clause) {
+                    list($e, $r) = self::getFields((array) $clause);
+                    $equality->addAll($e);
+                    $range->addAll($r);
+                }
+            } elseif (substr($field, 0, 1) === '$') {
+                continue;
+            } elseif (self::isEquality($value)) {
+                $equality[] = $field;
+            } else {
+                $range[] = $field;
+            }
+        }
+        return tuple($equality, $range);
+    }
+
+    /**
+     * Whether a criteria value is matched by equality.
+     *
+     * @param $value - The criteria value
+     * @return - Whether it's a plain value or uses only `$eq` or an `$in` with one value
+     */
+    private static function isEquality(mixed $value): bool
+    {
+        if ($value instanceof \MongoDB\BSON\Regex) {
+            return false;
+        }
+        if ($value instanceof \ConstMap) {
+            $value = $value->toArray();
+        }
+        if (!is_array($value) || count($value) === 0) {
+            return true;
+        }
+        foreach ($value as $k => $v) {
+            if (substr((string) $k, 0, 1) !== '$') {
+                return true;
+            } elseif ($k === '$in') {
+                if (!(is_array($v) || $v instanceof \ConstCollection) || count($v) !== 1) {
+                    return false;
+                }
+            } elseif ($k !== '$eq') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Finds the first caller outside of this class and the DAO.
+     *
+     * @return - The file and line
+     */
+    private static function getCallSite(): string
+    {
+        $skip = ImmSet{
+            __FILE__,
+            (new \ReflectionClass(AbstractMongoDao::class))->getFileName()
+        };
+        foreach (debug_backtrace(DEBUG_BACKTRACE_IGNORE_ARGS) as $frame) {
+            $file = (string) ($frame['file'] ?? '');
+            if ($file !== '' && !$skip->contains($file)) {
+                return $file . ':' . (string) ($frame['line'] ?? 0);
+            }
+        }
+        return 'unknown';
+    }
+}
@@ -0,0 +1,124 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * The changes needed to make the indexes of a collection match declarations.
+ *
+ * An index whose options differ from its declaration is both dropped and
+ * created, since MongoDB can't change an index in place.
+ *
+ * @since 0.8.0
+ */
+class IndexPlan
+{
+    /**
+     * Creates a new IndexPlan.
+     *
+     * @param $collection - The collection namespace
+     * @param $create - The indexes to create
+     * @param $drop - The names of the indexes to drop
+     * @param $keep - The names of the indexes which already match
+     * @param $reasons - Why indexes are kept, by name, if not because they match
+     */
+    public function __construct(
+        private string $collection,
+        private ImmVector<MongoIndex> $create,
+        private ImmSet<string> $drop,
+        private ImmSet<string> $keep,
+        private ?ImmMap<string,string> $reasons = null,
+    ) {
+    }
+
+    /**
+     * Gets the indexes to create.
+     *
+     * @return - The indexes to create
+     */
+    public function getCreate(): ImmVector<MongoIndex>
+    {
+        return $this->create;
+    }
+
+    /**
+     * Gets the names of the indexes to drop.
+     *
+     * @return - The index names
+     */
+    public function getDrop(): ImmSet<string>
+    {
+        return $this->drop;
+    }
+
+    /**
+     * Gets the names of the indexes which already match.
+     *
+     * @return - The index names
+     */
+    public function getKeep(): ImmSet<string>
+    {
+        return $this->keep;
+    }
+
+    /**
+     * Gets why indexes are kept.
+     *
+     * @return - The reasons, by index name
+     */
+    public function getReasons(): ImmMap<string,string>
+    {
+        return $this->reasons ?? ImmMap{};
+    }
+
+    /**
+     * Whether nothing needs to change.
+     *
+     * @return - Whether there is nothing to create or drop
+     */
+    public function isEmpty(): bool
+    {
+        return $this->create->isEmpty() && $this->drop->isEmpty();
+    }
+
+    /**
+     * Describes the plan, one line per index.
+     *
+     * Lines start with `-` for an index to drop, `+` for one to create, and
+     * `=` for one to keep, followed by why it's kept if known.
+     *
+     * @return - The plan as text
+     */
+    public function __toString(): string
+    {
+        $lines = Vector{"Indexes for {$this->collection}:"};
+        foreach ($this->drop as $name) {
+            $lines[] = "- $name";
+        }
+        foreach ($this->create as $index) {
+            $lines[] = '+ ' . $index->getName() . ' ' . json_encode($index->toArray());
+        }
+        $reasons = $this->getReasons();
+        foreach ($this->keep as $name) {
+            $reason = $reasons[$name] ?? null;
+            $lines[] = $reason === null ? "= $name" : "= $name ($reason)";
+        }
+        return implode(PHP_EOL, $lines);
+    }
+}
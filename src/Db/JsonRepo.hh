@@ -0,0 +1,45 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * Interface for entity services which can read documents straight into JSON.
+ *
+ * @since 0.8.0
+ */
+interface JsonRepo
+{
+    /**
+     * Finds several records by some arbitrary criteria, as JSON documents.
+     *
+     * No entities are created and nothing is cached.
+     *
+     * @param $criteria - Field to value pairs
+     * @param $pagination - Optional pagination parameters
+     * @param $totalCount - Return a `CursorSubset` that includes the total
+     *        number of records. This is only done if `$pagination` is not using
+     *        the defaults.
+     * @return - The JSON of each document found
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Unretrievable If the result cannot be returned
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    public function findJson(\ConstMap<string,mixed> $criteria, ?\Caridea\Http\Pagination $pagination = null, ?bool $totalCount = false): \Iterator<string>;
+}
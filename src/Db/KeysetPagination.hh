@@ -0,0 +1,232 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use Labrys\Getter;
+
+/**
+ * Pagination which seeks past the last item seen instead of skipping.
+ *
+ * The position is an opaque token holding the sort values and `_id` of the
+ * last item on the previous page. Queries use a range filter on those values,
+ * so the cost of a page doesn't grow with its depth. The `_id` field is always
+ * added as the final sort field to break ties.
+ *
+ * Tokens come from clients, so values holding query operators are refused,
+ * and equality is always matched with `$eq`. Given a secret, tokens are also
+ * signed with an HMAC, so only tokens made by `getToken` are accepted.
+ *
+ * @since 0.8.0
+ */
+class KeysetPagination extends \Caridea\Http\Pagination
+{
+    /**
+     * The sort values of the last item seen, or `null` for the first page
+     */
+    private ?ImmMap<string,mixed> $after;
+    /**
+     * The key used to sign tokens, if any
+     */
+    private ?string $secret;
+
+    /**
+     * Creates a new KeysetPagination.
+     *
+     * @param $max - The maximum number of items per page
+     * @param $order - The sort fields, `true` meaning ascending
+     * @param $token - The token of the last page, or `null` for the first page
+     * @param $secret - Optional key used to sign and verify tokens
+     * @throws \InvalidArgumentException if the token is invalid
+     */
+    public function __construct(int $max, KeyedTraversable<string,bool> $order = [], ?string $token = null, ?string $secret = null)
+    {
+        $this->secret = $secret;
+        $sorts = new Map($order);
+        if (!$sorts->containsKey('_id')) {
+            $sorts['_id'] = $sorts->isEmpty() ? true : (bool) $sorts->lastValue();
+        }
+        parent::__construct($max, 0, $sorts->toArray());
+        $this->after = $token === null ? null : $this->decode($token, $sorts->keys());
+    }
+
+    /**
+     * Gets the sort values of the last item seen.
+     *
+     * @return - The sort values, or `null` for the first page
+     */
+    public function getAfter(): ?ImmMap<string,mixed>
+    {
+        return $this->after;
+    }
+
+    /**
+     * Gets the range filter which seeks past the last item seen.
+     *
+     * For sort fields `a, b, _id` this is the equivalent of
+     * `a > x || (a = x && b > y) || (a = x && b = y && _id > z)`, with `<`
+     * instead for descending fields.
+     *
+     * @return - The filter, or `null` for the first page
+     */
+    public function toFilter(): ?array<string,mixed>
+    {
+        $after = $this->after;
+        if ($after === null) {
+            return null;
+        }
+        $or = [];
+        $equal = [];
+        foreach ($this->getOrder() as $field => $asc) {
+            $clause = $equal;
+            $clause[$field] = [($asc ? '$gt' : '$lt') => $after[$field]];
+            $or[] = $clause;
+            $equal[$field] = ['$eq' => $after[$field]];
+        }
+        return ['$or' => $or];
+    }
+
+    /**
+     * Creates the token pointing after an item.
+     *
+     * The item is best given as the document read, since a sort field an
+     * entity doesn't expose can't be read from it.
+     *
+     * @param $item - The last item of a page
+     * @return - The opaque token
+     * @throws \InvalidArgumentException if a sort field can't be read
+     */
+    public function getToken(mixed $item): string
+    {
+        $values = [];
+        foreach ($this->getOrder() as $field => $asc) {
+            $values[$field] = self::extract($item, $field);
+        }
+        $bson = \MongoDB\BSON\fromPHP($values);
+        $token = self::encode($bson);
+        return $this->secret === null ? $token :
+            $token . '.' . self::encode(hash_hmac('sha256', $bson, $this->secret, true));
+    }
+
+    /**
+     * Reads a token.
+     *
+     * @param $token - The opaque token
+     * @param $fields - The sort fields which must be present
+     * @return - The sort values
+     * @throws \InvalidArgumentException if the token is invalid
+     */
+    private function decode(string $token, \ConstVector<string> $fields): ImmMap<string,mixed>
+    {
+        $parts = explode('.', $token, 2);
+        $bson = base64_decode(strtr($parts[0], '-_', '+/'), true);
+        if ($this->secret !== null && $bson !== false) {
+            $mac = base64_decode(strtr($parts[1] ?? '', '-_', '+/'), true);
+            if ($mac === false || !hash_equals(hash_hmac('sha256', $bson, $this->secret, true), $mac)) {
+                throw new \InvalidArgumentException("Invalid pagination token signature");
+            }
+        }
+        try {
+            $values = $bson === false ? null :
+                \MongoDB\BSON\toPHP($bson, ['root' => 'array', 'document' => 'array', 'array' => 'array']);
+        } catch (\MongoDB\Driver\Exception\UnexpectedValueException $e) {
+            $values = null;
+        }
+        if (!is_array($values)) {
+            throw new \InvalidArgumentException("Invalid pagination token");
+        }
+        if (self::hasOperator($values)) {
+            throw new \InvalidArgumentException("Pagination token contains an operator");
+        }
+        foreach ($fields as $field) {
+            if (!array_key_exists($field, $values)) {
+                throw new \InvalidArgumentException("Pagination token is missing field: $field");
+            }
+        }
+        return new ImmMap($values);
+    }
+
+    /**
+     * Encodes bytes for a URL.
+     *
+     * @param $bytes - The bytes
+     * @return - The unpadded URL-safe Base64
+     */
+    private static function encode(string $bytes): string
+    {
+        return rtrim(strtr(base64_encode($bytes), '+/', '-_'), '=');
+    }
+
+    /**
+     * Whether a decoded value has any `$`-prefixed keys, at any depth.
+     *
+     * @param $value - The decoded value
+     * @return - Whether an operator was found
+     */
+    private static function hasOperator(array<arraykey,mixed> $value): bool
+    {
+        foreach ($value as $k => $v) {
+            if (is_string($k) && substr($k, 0, 1) === '$') {
+                return true;
+            } elseif (is_array($v) && self::hasOperator($v)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Gets a possibly nested field from an item.
+     *
+     * @param $item - The item
+     * @param $field - The field name, using dot notation for nested fields
+     * @return - The value or `null`
+     * @throws \InvalidArgumentException if an object doesn't expose the field
+     */
+    private static function extract(mixed $item, string $field): mixed
+    {
+        if ($field === '_id') {
+            return Getter::getId($item);
+        }
+        foreach (explode('.', $field) as $part) {
+            $value = Getter::get($item, $part);
+            if ($value === null && is_object($item) && !($item instanceof KeyedContainer) &&
+                !($item instanceof \stdClass) && !self::isReadable($item, $part)) {
+                // a null here would end the pagination without an error
+                throw new \InvalidArgumentException("Sort field '$field' can't be read from " . get_class($item));
+            }
+            $item = $value;
+        }
+        return $item;
+    }
+
+    /**
+     * Whether an object exposes a field to `Getter`.
+     *
+     * @param $item - The object
+     * @param $name - The field name
+     * @return - Whether it has a public property, a getter, or magic methods
+     */
+    private static function isReadable(mixed $item, string $name): bool
+    {
+        return array_key_exists($name, get_object_vars($item)) ||
+            method_exists($item, 'get' . ucfirst($name)) ||
+            method_exists($item, '__get') || method_exists($item, '__call');
+    }
+}
@@ -0,0 +1,67 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * A page of results fetched using `KeysetPagination`.
+ *
+ * @since 0.8.0
+ */
+class KeysetSubset<T> extends \IteratorIterator<T> implements \JsonSerializable
+{
+    /**
+     * Create a new KeysetSubset.
+     *
+     * @param $items - The items on this page
+     * @param $next - The token for the next page, or `null` if this is the last
+     */
+    public function __construct(private ImmVector<T> $items, private ?string $next)
+    {
+        parent::__construct($items);
+    }
+
+    /**
+     * Gets the token for the next page.
+     *
+     * @return - The token, or `null` if this is the last page
+     */
+    public function getNextToken(): ?string
+    {
+        return $this->next;
+    }
+
+    /**
+     * Return data which can be serialized with json_encode.
+     */
+    public function jsonSerialize(): mixed
+    {
+        return $this->items->toArray();
+    }
+
+    /**
+     * Converts this thing into an array.
+     *
+     * @return - The array version of this thing
+     */
+    public function toArray(): array<T>
+    {
+        return $this->items->toArray();
+    }
+}
@@ -0,0 +1,180 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * An entity cache with least-recently-used eviction.
+ *
+ * The cache can be bounded by number of entries, approximate number of bytes,
+ * or both. A limit of zero means unbounded. Entry sizes are only estimated
+ * when a byte limit is set.
+ *
+ * @since 0.8.0
+ */
+class LruEntityCache<T> implements EntityCache<T>
+{
+    /**
+     * The entries, least recently used first
+     */
+    private Map<string,T> $entries = Map{};
+    /**
+     * The estimated size of each entry
+     */
+    private Map<string,int> $sizes = Map{};
+    private int $bytes = 0;
+    private int $hits = 0;
+    private int $misses = 0;
+    private int $evictions = 0;
+
+    /**
+     * Creates a new LruEntityCache.
+     *
+     * @param $maxEntries - The maximum number of entries (0 for unlimited)
+     * @param $maxBytes - The maximum approximate size in bytes (0 for unlimited)
+     * @param $sizer - Optional function to estimate the size of an entity,
+     *        by default the length of its serialized form
+     * @throws \RangeException if either limit is negative
+     */
+    public function __construct(
+        private int $maxEntries = 0,
+        private int $maxBytes = 0,
+        private ?(function(T): int) $sizer = null,
+    ) {
+        if ($maxEntries < 0 || $maxBytes < 0) {
+            throw new \RangeException("Cache limits cannot be negative");
+        }
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function get(string $id): ?T
+    {
+        $entity = $this->entries[$id] ?? null;
+        if ($entity === null) {
+            $this->misses++;
+            return null;
+        }
+        $this->hits++;
+        // move to the most recently used end
+        $this->entries->removeKey($id);
+        $this->entries[$id] = $entity;
+        return $entity;
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function contains(string $id): bool
+    {
+        return $this->entries->containsKey($id);
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function add(string $id, T $entity): void
+    {
+        if (!$this->entries->containsKey($id)) {
+            $this->set($id, $entity);
+        }
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function set(string $id, T $entity): void
+    {
+        $this->remove($id);
+        $this->entries[$id] = $entity;
+        if ($this->maxBytes > 0) {
+            $size = $this->sizeOf($entity);
+            $this->sizes[$id] = $size;
+            $this->bytes += $size;
+        }
+        $this->evict();
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function remove(string $id): void
+    {
+        if ($this->entries->containsKey($id)) {
+            $this->entries->removeKey($id);
+            $this->bytes -= $this->sizes[$id] ?? 0;
+            $this->sizes->removeKey($id);
+        }
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function clear(): void
+    {
+        $this->entries->clear();
+        $this->sizes->clear();
+        $this->bytes = 0;
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function getStats(): CacheStats
+    {
+        return shape(
+            'hits' => $this->hits,
+            'misses' => $this->misses,
+            'evictions' => $this->evictions,
+            'entries' => $this->entries->count(),
+            'bytes' => $this->bytes,
+        );
+    }
+
+    /**
+     * Removes least recently used entries until the cache is within limits.
+     *
+     * The most recently added entry is never evicted.
+     */
+    private function evict(): void
+    {
+        while ($this->entries->count() > 1 && (
+            ($this->maxEntries > 0 && $this->entries->count() > $this->maxEntries) ||
+            ($this->maxBytes > 0 && $this->bytes > $this->maxBytes)
+        )) {
+            $id = $this->entries->firstKey();
+            invariant($id !== null, 'The cache is not empty');
+            $this->remove($id);
+            $this->evictions++;
+        }
+    }
+
+    /**
+     * Estimates the size of an entity.
+     *
+     * @param $entity - The entity
+     * @return - The approximate size in bytes
+     */
+    private function sizeOf(T $entity): int
+    {
+        $sizer = $this->sizer;
+        return $sizer === null ? strlen(serialize($entity)) : $sizer($entity);
+    }
+}
@@ -36,8 +36,9 @@ class MongoFileService implements \Labrys\Io\FileService<ObjectID,\stdClass>
      * Creates a new MongoFileService
      *
      * @param $bucket - The GridFS Bucket
+     * @param $profiler - Optional profiler to record each operation
      */
-    public function __construct(private Bucket $bucket)
+    public function __construct(private Bucket $bucket, private ?Profiler $profiler = null)
     {
     }
 
@@ -170,7 +171,8 @@ class MongoFileService implements \Labrys\Io\FileService<ObjectID,\stdClass>
     /**
      * Executes something in the context of the collection.
      *
-     * Exceptions are caught and translated.
+     * Exceptions are caught and translated. If there is a profiler which
+     * isn't subscribed to the driver, the call is timed and recorded.
      *
      * @param $cb - The closure to execute, takes the Bucket
      * @return - Whatever the function returns, this method also returns
@@ -178,10 +180,29 @@ class MongoFileService implements \Labrys\Io\FileService<ObjectID,\stdClass>
      */
     protected function doExecute<Ta>((function(Bucket): Ta) $cb) : Ta
     {
+        $start = microtime(true);
+        $documents = 0;
         try {
-            return $cb($this->bucket);
+            $result = $cb($this->bucket);
+            // a cursor can't be counted without reading it
+            if (is_object($result) && !($result instanceof \Traversable)) {
+                $documents = 1;
+            }
+            return $result;
         } catch (\Exception $e) {
             throw \Caridea\Dao\Exception\Translator\MongoDb::translate($e);
+        } finally {
+            $profiler = $this->profiler;
+            if ($profiler !== null && !$profiler->isSubscribed()) {
+                $frames = debug_backtrace(DEBUG_BACKTRACE_IGNORE_ARGS, 2);
+                $profiler->record(
+                    $this->bucket->getBucketName(),
+                    (string) ($frames[1]['function'] ?? 'doExecute'),
+                    null,
+                    (microtime(true) - $start) * 1000,
+                    $documents
+                );
+            }
         }
     }
 
@@ -81,6 +81,39 @@ class MongoIndex
         $this->values = $values->toImmMap();
     }
 
+    /**
+     * Gets the key definition of this index.
+     *
+     * @return - The field names to direction or index type, in order
+     * @since 0.8.0
+     */
+    public function getKeys(): ImmMap<string,mixed>
+    {
+        return new ImmMap((array) $this->values['key']);
+    }
+
+    /**
+     * Gets the name of this index.
+     *
+     * If no name was given, this is the name MongoDB would generate from the
+     * keys, for example `owner_1_created_-1`.
+     *
+     * @return - The index name
+     * @since 0.8.0
+     */
+    public function getName(): string
+    {
+        $name = $this->values['name'] ?? null;
+        if ($name !== null) {
+            return (string) $name;
+        }
+        $parts = [];
+        foreach ($this->getKeys() as $k => $v) {
+            $parts[] = $k . '_' . (string) $v;
+        }
+        return implode('_', $parts);
+    }
+
     /**
      * Gets the array version of this index.
      *
@@ -103,4 +103,399 @@ trait MongoIndexHelper
             throw \Caridea\Dao\Exception\Translator\MongoDb::translate($e);
         }
     }
+
+    /**
+     * Compares declared indexes with those in a collection.
+     *
+     * Indexes are matched by name, or by the generated name if none was
+     * declared. An index matches if it has the same keys, and the same value
+     * for each declared option and for `unique`, `sparse`,
+     * `expireAfterSeconds`, and `partialFilterExpression`. Other options the
+     * server fills in, and `background`, aren't compared. The server fills in
+     * defaults within `collation` and `weights`, so only their declared
+     * fields are compared. Indexes which aren't declared are only dropped if
+     * `$dropObsolete` is set, and the `_id_` index is never dropped.
+     *
+     * @param $manager - The MongoDB manager
+     * @param $db - The database name
+     * @param $collection - The collection name
+     * @param $indexes - The declared indexes
+     * @param $dropObsolete - Whether indexes which aren't declared are dropped
+     * @return - The changes needed
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function planIndexes(\MongoDB\Driver\Manager $manager, string $db, string $collection, \ConstVector<MongoIndex> $indexes, bool $dropObsolete = false): IndexPlan
+    {
+        $existing = Map{};
+        try {
+            $server = $manager->selectServer(new ReadPreference(ReadPreference::RP_PRIMARY));
+            $op = new ListIndexes($db, $collection);
+            foreach ($op->execute($server) as $info) {
+                $existing[$info->getName()] = $info->__debugInfo();
+            }
+        } catch (\Exception $e) {
+            throw \Caridea\Dao\Exception\Translator\MongoDb::translate($e);
+        }
+        $create = Vector{};
+        $drop = Set{};
+        $keep = Set{};
+        $declared = Set{};
+        foreach ($indexes as $index) {
+            $name = $index->getName();
+            $declared[] = $name;
+            $current = $existing[$name] ?? null;
+            if ($current === null) {
+                $create[] = $index;
+            } elseif (self::isSameIndex($index->toArray(), $current)) {
+                $keep[] = $name;
+            } else {
+                $drop[] = $name;
+                $create[] = $index;
+            }
+        }
+        if ($dropObsolete) {
+            foreach ($existing->keys() as $name) {
+                if ($name !== '_id_' && !$declared->contains($name)) {
+                    $drop[] = $name;
+                }
+            }
+        }
+        return new IndexPlan("$db.$collection", $create->toImmVector(), $drop->toImmSet(), $keep->toImmSet());
+    }
+
+    /**
+     * Makes the indexes in a collection match those declared.
+     *
+     * An index whose definition changed is first built under a temporary
+     * name, with `_id` appended to its keys, since the server won't hold two
+     * indexes on the same keys. This keeps queries covered while the old index
+     * is dropped and the new one is built under its own name; the temporary
+     * index is dropped last. It can't enforce a unique constraint, though, so
+     * give a changed unique index a new name to keep its constraint throughout.
+     *
+     * Indexes are dropped in one `dropIndexes` command, which requires MongoDB
+     * 4.2 to drop more than one, and created in one `createIndexes` command,
+     * each with `background` set so the collection stays writable. The build
+     * can be followed from another process with `getIndexBuilds`.
+     *
+     * @param $manager - The MongoDB manager
+     * @param $db - The database name
+     * @param $collection - The collection name
+     * @param $indexes - The declared indexes
+     * @param $dryRun - Whether to only plan the changes, not make them
+     * @param $dropObsolete - Whether indexes which aren't declared are dropped
+     * @param $progress - Optional function called with a message before each step
+     * @return - The changes made, or needed for a dry run
+     * @see https://docs.mongodb.com/manual/reference/command/createIndexes/
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Inoperable If an API is used incorrectly
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function reconcileIndexes(\MongoDB\Driver\Manager $manager, string $db, string $collection, \ConstVector<MongoIndex> $indexes, bool $dryRun = false, bool $dropObsolete = false, ?(function(string): void) $progress = null): IndexPlan
+    {
+        $plan = $this->planIndexes($manager, $db, $collection, $indexes, $dropObsolete);
+        if ($dryRun || $plan->isEmpty()) {
+            return $plan;
+        }
+        try {
+            $drop = $plan->getDrop();
+            $create = $plan->getCreate();
+            $interim = $create->filter($a ==> $drop->contains($a->getName()) &&
+                !$a->getKeys()->containsKey('_id') &&
+                !in_array('hashed', $a->getKeys()->toArray(), true));
+            if (!$interim->isEmpty()) {
+                $this->buildIndexes($manager, $db, $collection, $interim->map($a ==> [
+                    'key' => array_merge($a->getKeys()->toArray(), ['_id' => 1]),
+                    'name' => $a->getName() . '_interim',
+                ]), $progress);
+            }
+            if (!$drop->isEmpty()) {
+                $this->dropIndexNames($manager, $db, $collection, $drop, $progress);
+            }
+            if (!$create->isEmpty()) {
+                $this->buildIndexes($manager, $db, $collection, $create->map($a ==> array_merge($a->toArray(), ['name' => $a->getName()])), $progress);
+            }
+            if (!$interim->isEmpty()) {
+                $this->dropIndexNames($manager, $db, $collection, $interim->map($a ==> $a->getName() . '_interim')->toImmSet(), $progress);
+            }
+            if ($progress !== null) {
+                $progress("Indexes on $db.$collection are up to date");
+            }
+        } catch (\Exception $e) {
+            throw \Caridea\Dao\Exception\Translator\MongoDb::translate($e);
+        }
+        return $plan;
+    }
+
+    /**
+     * Builds indexes in the background with one `createIndexes` command.
+     *
+     * @param $manager - The MongoDB manager
+     * @param $db - The database name
+     * @param $collection - The collection name
+     * @param $indexes - The index specifications, each with a name
+     * @param $progress - Optional function called with a message first
+     */
+    private function buildIndexes(\MongoDB\Driver\Manager $manager, string $db, string $collection, \ConstVector<array<string,mixed>> $indexes, ?(function(string): void) $progress): void
+    {
+        if ($progress !== null) {
+            $progress("Creating indexes on $db.$collection: " . implode(', ', $indexes->map($a ==> $a['name'])));
+        }
+        $operation = new CreateIndexes(
+            $db, $collection,
+            $indexes->map($a ==> array_merge($a, ['background' => true]))->toArray()
+        );
+        $operation->execute($manager->selectServer(new ReadPreference(ReadPreference::RP_PRIMARY)));
+    }
+
+    /**
+     * Drops indexes by name with one `dropIndexes` command.
+     *
+     * @param $manager - The MongoDB manager
+     * @param $db - The database name
+     * @param $collection - The collection name
+     * @param $names - The index names
+     * @param $progress - Optional function called with a message first
+     */
+    private function dropIndexNames(\MongoDB\Driver\Manager $manager, string $db, string $collection, \ConstSet<string> $names, ?(function(string): void) $progress): void
+    {
+        if ($progress !== null) {
+            $progress("Dropping indexes on $db.$collection: " . implode(', ', $names));
+        }
+        $manager->executeCommand($db, new \MongoDB\Driver\Command([
+            'dropIndexes' => $collection,
+            'index' => $names->count() === 1 ? $names->firstValue() : $names->toValuesArray(),
+        ]));
+    }
+
+    /**
+     * Gets the progress of index builds running on a collection.
+     *
+     * @param $manager - The MongoDB manager
+     * @param $db - The database name
+     * @param $collection - The collection name
+     * @return - The builds in progress
+     * @see https://docs.mongodb.com/manual/reference/method/db.currentOp/
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function getIndexBuilds(\MongoDB\Driver\Manager $manager, string $db, string $collection): ImmVector<IndexBuild>
+    {
+        try {
+            $cursor = $manager->executeCommand('admin', new \MongoDB\Driver\Command([
+                'currentOp' => 1,
+                'command.createIndexes' => $collection,
+                'ns' => new \MongoDB\BSON\Regex('^' . preg_quote($db) . '\\.', ''),
+            ]), new ReadPreference(ReadPreference::RP_PRIMARY));
+            $cursor->setTypeMap(['root' => 'array', 'document' => 'array', 'array' => 'array']);
+            $result = current($cursor->toArray());
+        } catch (\Exception $e) {
+            throw \Caridea\Dao\Exception\Translator\MongoDb::translate($e);
+        }
+        $builds = Vector{};
+        foreach ((array) ($result['inprog'] ?? []) as $op) {
+            $builds[] = shape(
+                'opid' => $op['opid'] ?? null,
+                'message' => (string) ($op['msg'] ?? ''),
+                'done' => (int) ($op['progress']['done'] ?? 0),
+                'total' => (int) ($op['progress']['total'] ?? 0),
+                'seconds' => (int) ($op['secs_running'] ?? 0),
+            );
+        }
+        return $builds->toImmVector();
+    }
+
+    /**
+     * Reports how much each index in a collection is used.
+     *
+     * Usage comes from `$indexStats`, which only counts operations on the
+     * server queried since it started, so run this against each member that
+     * takes reads. Sizes come from `collStats`, and the write count from the
+     * `latencyStats` of `$collStats` (MongoDB 3.4+), or 0 if unavailable.
+     *
+     * An index is `unused` with no operations, and `negligible` if its
+     * operations are fewer than `$negligible` times the writes which had to
+     * maintain it.
+     *
+     * @param $manager - The MongoDB manager
+     * @param $db - The database name
+     * @param $collection - The collection name
+     * @param $indexes - The declared indexes, to tell which ones are declared
+     * @param $negligible - The ratio of operations to writes below which an
+     *        index is negligible
+     * @return - The usage of each index, the least used first
+     * @see https://docs.mongodb.com/manual/reference/operator/aggregation/indexStats/
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     * @since 0.8.0
+     */
+    protected function getIndexUsage(\MongoDB\Driver\Manager $manager, string $db, string $collection, \ConstVector<MongoIndex> $indexes, float $negligible = 0.001): ImmVector<IndexUsage>
+    {
+        $typeMap = ['root' => 'array', 'document' => 'array', 'array' => 'array'];
+        $rp = new ReadPreference(ReadPreference::RP_PRIMARY);
+        try {
+            $stats = $manager->executeCommand($db, new \MongoDB\Driver\Command([
+                'aggregate' => $collection,
+                'pipeline' => [['$indexStats' => new \stdClass()]],
+                'cursor' => new \stdClass(),
+            ]), $rp);
+            $stats->setTypeMap($typeMap);
+            $stats = $stats->toArray();
+            $coll = $manager->executeCommand($db, new \MongoDB\Driver\Command(['collStats' => $collection]), $rp);
+            $coll->setTypeMap($typeMap);
+            $sizes = (array) (current($coll->toArray())['indexSizes'] ?? []);
+            $constraints = Map{};
+            $op = new ListIndexes($db, $collection);
+            foreach ($op->execute($manager->selectServer($rp)) as $info) {
+                if ($info->isUnique()) {
+                    $constraints[$info->getName()] = 'unique';
+                } elseif ($info->isTtl()) {
+                    $constraints[$info->getName()] = 'ttl';
+                }
+            }
+        } catch (\Exception $e) {
+            throw \Caridea\Dao\Exception\Translator\MongoDb::translate($e);
+        }
+        $writes = 0;
+        try {
+            $latency = $manager->executeCommand($db, new \MongoDB\Driver\Command([
+                'aggregate' => $collection,
+                'pipeline' => [['$collStats' => ['latencyStats' => new \stdClass()]]],
+                'cursor' => new \stdClass(),
+            ]), $rp);
+            $latency->setTypeMap($typeMap);
+            foreach ($latency as $doc) {
+                $writes += (int) ($doc['latencyStats']['writes']['ops'] ?? 0);
+            }
+        } catch (\MongoDB\Driver\Exception\RuntimeException $e) {
+            // older servers don't have $collStats
+        }
+        $declared = $indexes->map($a ==> $a->getName())->toSet();
+        $usage = Vector{};
+        foreach ($stats as $stat) {
+            $name = (string) ($stat['name'] ?? '');
+            $ops = (int) ($stat['accesses']['ops'] ?? 0);
+            $since = $stat['accesses']['since'] ?? null;
+            $usage[] = shape(
+                'name' => $name,
+                'declared' => $declared->contains($name),
+                'constraint' => $constraints[$name] ?? null,
+                'ops' => $ops,
+                'since' => $since instanceof \MongoDB\BSON\UTCDateTime ?
+                    \DateTimeImmutable::createFromMutable($since->toDateTime()) : null,
+                'bytes' => (int) ($sizes[$name] ?? 0),
+                'writes' => $writes,
+                'status' => $ops === 0 ? 'unused' :
+                    ($ops < $writes * $negligible ? 'negligible' : 'used'),
+            );
+        }
+        $sorted = $usage->toArray();
+        usort($sorted, ($a, $b) ==> $a['ops'] - $b['ops']);
+        return new ImmVector($sorted);
+    }
+
+    /**
+     * Plans to drop the indexes which are unused or negligible.
+     *
+     * The `_id_` index, declared indexes, and unique or TTL indexes are always
+     * kept, since dropping them would lose a constraint or break a later
+     * reconcile. A partial unique index is a unique index. The plan can be
+     * printed for review, and its names passed to `dropIndexes`.
+     *
+     * @param $collection - The collection namespace
+     * @param $usage - The usage report from `getIndexUsage`
+     * @param $negligible - Whether to drop negligible indexes as well as unused ones
+     * @return - The plan
+     * @since 0.8.0
+     */
+    protected function planUnusedIndexDrops(string $collection, Traversable<IndexUsage> $usage, bool $negligible = false): IndexPlan
+    {
+        $drop = Set{};
+        $keep = Set{};
+        $reasons = Map{};
+        foreach ($usage as $index) {
+            $name = $index['name'];
+            $unused = $index['status'] === 'unused' ||
+                ($negligible && $index['status'] === 'negligible');
+            if ($name === '_id_') {
+                $reasons[$name] = 'primary key';
+            } elseif ($index['constraint'] !== null) {
+                $reasons[$name] = (string) $index['constraint'];
+            } elseif ($index['declared']) {
+                $reasons[$name] = 'declared';
+            } elseif ($unused) {
+                $drop[] = $name;
+                continue;
+            } else {
+                $reasons[$name] = $index['status'];
+            }
+            $keep[] = $name;
+        }
+        return new IndexPlan($collection, ImmVector{}, $drop->toImmSet(), $keep->toImmSet(), $reasons->toImmMap());
+    }
+
+    /**
+     * Whether an existing index matches a declared one.
+     *
+     * Numbers are compared as floats, since the shell stores `1` as a double,
+     * and false options are the same as missing ones. The keys of a text
+     * index aren't compared, since the server stores them differently.
+     *
+     * @param $declared - The declared index definition
+     * @param $existing - The existing index definition
+     * @return - Whether they match
+     */
+    private static function isSameIndex(array<string,mixed> $declared, array<string,mixed> $existing): bool
+    {
+        $keys = (array) self::normalizeIndexValue($existing['key'] ?? []);
+        if (!array_key_exists('_fts', $keys) &&
+            $keys !== self::normalizeIndexValue($declared['key'] ?? [])) {
+            return false;
+        }
+        $compared = array_merge(
+            array_keys($declared),
+            ['unique', 'sparse', 'expireAfterSeconds', 'partialFilterExpression']
+        );
+        foreach ($compared as $k) {
+            if ($k === 'key' || $k === 'name' || $k === 'background') {
+                continue;
+            }
+            $a = self::normalizeIndexValue($declared[$k] ?? false);
+            $b = self::normalizeIndexValue($existing[$k] ?? false);
+            if (($k === 'collation' || $k === 'weights') && is_array($a) && is_array($b)) {
+                // the server fills in defaults for the fields left out
+                $b = array_intersect_key($b, $a);
+                ksort($a);
+                ksort($b);
+            }
+            if ($a !== $b) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Turns documents into arrays and numbers into floats.
+     *
+     * @param $value - The value to normalize
+     * @return - The normalized value
+     */
+    private static function normalizeIndexValue(mixed $value): mixed
+    {
+        if ($value instanceof \Traversable) {
+            $value = iterator_to_array($value);
+        } elseif ($value instanceof \stdClass) {
+            $value = (array) $value;
+        }
+        if (is_array($value)) {
+            return array_map($a ==> self::normalizeIndexValue($a), $value);
+        }
+        return is_int($value) ? (float) $value : $value;
+    }
 }
@@ -0,0 +1,117 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * A read-only view of some of the fields of a document.
+ *
+ * Instances are produced by projected queries; nested documents are
+ * unserialized using the DAO's `typeMap`.
+ *
+ * @since 0.8.0
+ */
+class PartialEntity implements \MongoDB\BSON\Unserializable, \ArrayAccess<string,mixed>, \JsonSerializable
+{
+    /**
+     * The fields present in the document
+     */
+    private ImmMap<string,mixed> $values = ImmMap{};
+
+    /**
+     * Gets the document identifier.
+     *
+     * @return - The document identifier, or `null`
+     */
+    public function getId(): mixed
+    {
+        return $this->values['_id'] ?? null;
+    }
+
+    /**
+     * Gets a field value.
+     *
+     * @param $field - The field name
+     * @return - The value or `null` if the field wasn't loaded
+     */
+    public function get(string $field): mixed
+    {
+        return $this->values[$field] ?? null;
+    }
+
+    /**
+     * Gets the fields present in the document.
+     *
+     * @return - The field values
+     */
+    public function getValues(): ImmMap<string,mixed>
+    {
+        return $this->values;
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function bsonUnserialize(array $data): void
+    {
+        $this->values = new ImmMap($data);
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function offsetExists(mixed $offset): bool
+    {
+        return $this->values->containsKey((string) $offset);
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function offsetGet(mixed $offset): mixed
+    {
+        return $this->values[(string) $offset] ?? null;
+    }
+
+    /**
+     * {@inheritDoc}
+     * @throws \LogicException always; partial entities are read-only
+     */
+    public function offsetSet(mixed $offset, mixed $value): void
+    {
+        throw new \LogicException("Partial entities are read-only");
+    }
+
+    /**
+     * {@inheritDoc}
+     * @throws \LogicException always; partial entities are read-only
+     */
+    public function offsetUnset(mixed $offset): void
+    {
+        throw new \LogicException("Partial entities are read-only");
+    }
+
+    /**
+     * Return data which can be serialized with json_encode.
+     */
+    public function jsonSerialize(): mixed
+    {
+        return $this->values->toArray();
+    }
+}
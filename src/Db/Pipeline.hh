@@ -0,0 +1,222 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * Builds a MongoDB aggregation pipeline.
+ *
+ * ```hack
+ * $pipeline = (new Pipeline())
+ *     ->match(['status' => 'active'])
+ *     ->group(['_id' => '$owner', 'total' => ['$sum' => 1]])
+ *     ->sort(['total' => false])
+ *     ->limit(10);
+ * ```
+ *
+ * Hack collections given to any stage are converted to arrays so they encode
+ * as BSON documents.
+ *
+ * @since 0.8.0
+ */
+class Pipeline implements \IteratorAggregate<\ConstMap<string,mixed>>
+{
+    /**
+     * The stages
+     */
+    private Vector<ImmMap<string,mixed>> $stages = Vector{};
+
+    /**
+     * Adds a `$match` stage.
+     *
+     * @param $criteria - The query criteria
+     * @return - provides a fluent interface
+     */
+    public function match(KeyedTraversable<string,mixed> $criteria): this
+    {
+        return $this->stage('$match', $criteria);
+    }
+
+    /**
+     * Adds a `$project` stage.
+     *
+     * @param $projections - Field name to projection value or expression
+     * @return - provides a fluent interface
+     */
+    public function project(KeyedTraversable<string,mixed> $projections): this
+    {
+        return $this->stage('$project', $projections);
+    }
+
+    /**
+     * Adds an `$addFields` stage.
+     *
+     * @param $fields - Field name to expression
+     * @return - provides a fluent interface
+     */
+    public function addFields(KeyedTraversable<string,mixed> $fields): this
+    {
+        return $this->stage('$addFields', $fields);
+    }
+
+    /**
+     * Adds a `$group` stage.
+     *
+     * @param $group - The `_id` expression and accumulators
+     * @return - provides a fluent interface
+     */
+    public function group(KeyedTraversable<string,mixed> $group): this
+    {
+        return $this->stage('$group', $group);
+    }
+
+    /**
+     * Adds a `$sort` stage.
+     *
+     * @param $order - Field name to direction, `true` meaning ascending
+     * @return - provides a fluent interface
+     */
+    public function sort(KeyedTraversable<string,bool> $order): this
+    {
+        $sorts = [];
+        foreach ($order as $k => $v) {
+            $sorts[$k] = $v ? 1 : -1;
+        }
+        return $this->stage('$sort', $sorts);
+    }
+
+    /**
+     * Adds a `$skip` stage.
+     *
+     * @param $skip - The number of documents to skip
+     * @return - provides a fluent interface
+     */
+    public function skip(int $skip): this
+    {
+        return $this->stage('$skip', $skip);
+    }
+
+    /**
+     * Adds a `$limit` stage.
+     *
+     * @param $limit - The maximum number of documents
+     * @return - provides a fluent interface
+     */
+    public function limit(int $limit): this
+    {
+        return $this->stage('$limit', $limit);
+    }
+
+    /**
+     * Adds an `$unwind` stage.
+     *
+     * @param $path - The array field path, without the leading `$`
+     * @param $preserveNullAndEmptyArrays - Whether to keep documents without
+     *        any array elements
+     * @return - provides a fluent interface
+     */
+    public function unwind(string $path, bool $preserveNullAndEmptyArrays = false): this
+    {
+        return $this->stage('$unwind', [
+            'path' => "\$$path",
+            'preserveNullAndEmptyArrays' => $preserveNullAndEmptyArrays,
+        ]);
+    }
+
+    /**
+     * Adds a `$lookup` stage.
+     *
+     * @param $from - The collection to join
+     * @param $localField - The field in the input documents
+     * @param $foreignField - The field in the joined documents
+     * @param $as - The output array field
+     * @return - provides a fluent interface
+     */
+    public function lookup(string $from, string $localField, string $foreignField, string $as): this
+    {
+        return $this->stage('$lookup', [
+            'from' => $from,
+            'localField' => $localField,
+            'foreignField' => $foreignField,
+            'as' => $as,
+        ]);
+    }
+
+    /**
+     * Adds a `$count` stage.
+     *
+     * @param $field - The output field name
+     * @return - provides a fluent interface
+     */
+    public function count(string $field): this
+    {
+        return $this->stage('$count', $field);
+    }
+
+    /**
+     * Adds any stage.
+     *
+     * @param $operator - The stage operator, e.g. `$sample`
+     * @param $value - The stage specification
+     * @return - provides a fluent interface
+     */
+    public function stage(string $operator, mixed $value): this
+    {
+        $this->stages[] = ImmMap{$operator => self::toBson($value)};
+        return $this;
+    }
+
+    /**
+     * Gets an iterator over the stages.
+     *
+     * @return - The stages
+     */
+    public function getIterator(): \Iterator<\ConstMap<string,mixed>>
+    {
+        return $this->stages->getIterator();
+    }
+
+    /**
+     * Gets the array version of this pipeline.
+     *
+     * @return - The stages as arrays
+     */
+    public function toArray(): array<array<string,mixed>>
+    {
+        return $this->stages->map($a ==> $a->toArray())->toArray();
+    }
+
+    /**
+     * Converts Hack collections into arrays.
+     *
+     * @param $value - The value to convert
+     * @return - The converted value
+     */
+    private static function toBson(mixed $value): mixed
+    {
+        if (is_array($value)) {
+            return array_map($a ==> self::toBson($a), $value);
+        } elseif ($value instanceof \ConstMap || $value instanceof \ConstVector) {
+            return array_map($a ==> self::toBson($a), $value->toArray());
+        } elseif ($value instanceof \ConstSet) {
+            return array_map($a ==> self::toBson($a), $value->values()->toArray());
+        }
+        return $value;
+    }
+}
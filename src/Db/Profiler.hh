@@ -0,0 +1,254 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use Psr\Log\LoggerInterface as Logger;
+
+/**
+ * Records the MongoDB commands run during a request.
+ *
+ * Commands at least as slow as the threshold are logged as they happen. The
+ * summary counts commands, their total time, and cache hits and misses, and
+ * points out commands repeated with the same criteria shape, which are
+ * usually an N+1 query pattern that a batched load would avoid.
+ *
+ * ```hack
+ * $profiler = new Profiler($errorLogger->getLogger(), 50);
+ * $profiler->subscribe('db');
+ * $dao = new MyDao($manager, 'db.coll', Map{'profiler' => $profiler});
+ * // at the end of the request
+ * $profiler->unsubscribe();
+ * $profiler->logSummary();
+ * ```
+ *
+ * @since 0.8.0
+ */
+class Profiler
+{
+    /**
+     * The commands recorded, in order
+     */
+    private Vector<ProfiledCommand> $commands = Vector{};
+    private int $cacheHits = 0;
+    private int $cacheMisses = 0;
+    /**
+     * The driver subscriber recording commands, if any
+     */
+    private ?ProfilerSubscriber $subscriber;
+
+    /**
+     * Creates a new Profiler.
+     *
+     * @param $logger - The logger for slow commands; will use `Psr\Log\NullLogger` by default
+     * @param $slowMs - Commands taking at least this many milliseconds are logged
+     * @param $repeats - Commands with the same shape run at least this many
+     *        times are reported as an N+1 pattern
+     */
+    public function __construct(
+        private ?Logger $logger = null,
+        private float $slowMs = 100.0,
+        private int $repeats = 5,
+    ) {
+        $this->logger = $logger ?? new \Psr\Log\NullLogger();
+    }
+
+    /**
+     * Records commands using the driver's monitoring API, if it's available.
+     *
+     * Once subscribed, the DAOs using this profiler no longer time their own
+     * commands. Driver subscribers are global to the process, so call
+     * `unsubscribe` when the request is done.
+     *
+     * @param $namespace - Optional database name, or database and collection
+     *        name, to record commands for; others are ignored
+     * @return - Whether the subscriber could be added
+     */
+    public function subscribe(?string $namespace = null): bool
+    {
+        if ($this->subscriber === null && interface_exists('MongoDB\Driver\Monitoring\CommandSubscriber')) {
+            $this->subscriber = ProfilerSubscriber::register($this, $namespace);
+        }
+        return $this->subscriber !== null;
+    }
+
+    /**
+     * Removes the driver subscriber, if there is one.
+     *
+     * DAOs using this profiler go back to timing their own commands.
+     */
+    public function unsubscribe(): void
+    {
+        $subscriber = $this->subscriber;
+        if ($subscriber !== null) {
+            $subscriber->unregister();
+            $this->subscriber = null;
+        }
+    }
+
+    /**
+     * Gets whether commands are recorded by a driver subscriber.
+     *
+     * @return - Whether the subscriber was added
+     */
+    public function isSubscribed(): bool
+    {
+        return $this->subscriber !== null;
+    }
+
+    /**
+     * Records a command.
+     *
+     * @param $collection - The collection name
+     * @param $operation - The command or method name
+     * @param $criteria - The query criteria; only its shape is kept
+     * @param $ms - The duration in milliseconds
+     * @param $documents - The number of documents returned or written
+     * @return - The position of the command, for `addDocuments`
+     */
+    public function record(string $collection, string $operation, mixed $criteria, float $ms, int $documents = 0): int
+    {
+        $command = shape(
+            'collection' => $collection,
+            'operation' => $operation,
+            'shape' => json_encode(self::shapeOf($criteria)),
+            'ms' => $ms,
+            'documents' => $documents,
+        );
+        $this->commands[] = $command;
+        if ($ms >= $this->slowMs) {
+            /* HH_IGNORE_ERROR[4064]: This isn't null, we set it in the constructor */
+            $this->logger->warning(
+                "Slow MongoDB {operation} on {collection}: {ms} ms",
+                $command
+            );
+        }
+        return $this->commands->count() - 1;
+    }
+
+    /**
+     * Adds documents to a recorded command, like those read from a cursor
+     * after the command finished.
+     *
+     * @param $position - The position returned by `record`
+     * @param $documents - The number of documents to add
+     */
+    public function addDocuments(int $position, int $documents): void
+    {
+        $command = $this->commands->get($position);
+        if ($command !== null) {
+            $command['documents'] += $documents;
+            $this->commands[$position] = $command;
+        }
+    }
+
+    /**
+     * Records a first-level cache lookup.
+     *
+     * @param $hit - Whether the entity was found in the cache
+     */
+    public function recordCache(bool $hit): void
+    {
+        if ($hit) {
+            $this->cacheHits++;
+        } else {
+            $this->cacheMisses++;
+        }
+    }
+
+    /**
+     * Gets the commands recorded so far.
+     *
+     * @return - The commands, in order
+     */
+    public function getCommands(): ImmVector<ProfiledCommand>
+    {
+        return $this->commands->toImmVector();
+    }
+
+    /**
+     * Summarizes the commands recorded so far.
+     *
+     * @return - The summary
+     */
+    public function getSummary(): ProfileSummary
+    {
+        $ms = 0.0;
+        $counts = Map{};
+        foreach ($this->commands as $command) {
+            $ms += $command['ms'];
+            $key = $command['collection'] . ' ' . $command['operation'] . ' ' . $command['shape'];
+            $counts[$key] = ($counts[$key] ?? 0) + 1;
+        }
+        return shape(
+            'count' => $this->commands->count(),
+            'ms' => $ms,
+            'cacheHits' => $this->cacheHits,
+            'cacheMisses' => $this->cacheMisses,
+            'repeats' => $counts->filter($a ==> $a >= $this->repeats)->toImmMap(),
+        );
+    }
+
+    /**
+     * Logs the summary, and each N+1 pattern as a warning.
+     */
+    public function logSummary(): void
+    {
+        $summary = $this->getSummary();
+        /* HH_IGNORE_ERROR[4064]: This isn't null, we set it in the constructor */
+        $this->logger->info(
+            "MongoDB: {count} commands in {ms} ms, {cacheHits} cache hits, {cacheMisses} cache misses",
+            $summary
+        );
+        foreach ($summary['repeats'] as $key => $count) {
+            /* HH_IGNORE_ERROR[4064]: This isn't null, we set it in the constructor */
+            $this->logger->warning(
+                "Possible N+1 query: {command} run {times} times",
+                ['command' => $key, 'times' => $count]
+            );
+        }
+    }
+
+    /**
+     * Replaces every value in some criteria with `1`, keeping the field
+     * names and operators.
+     *
+     * @param $criteria - The criteria
+     * @return - The shape of the criteria
+     */
+    public static function shapeOf(mixed $criteria): mixed
+    {
+        if ($criteria instanceof \MongoDB\BSON\Serializable) {
+            $criteria = $criteria->bsonSerialize();
+        }
+        if ($criteria instanceof \MongoDB\BSON\Type) {
+            return 1;
+        } elseif ($criteria instanceof KeyedTraversable || is_array($criteria) || $criteria instanceof \stdClass) {
+            $shape = [];
+            $list = true;
+            foreach ((array) ($criteria instanceof KeyedTraversable ? iterator_to_array($criteria) : $criteria) as $k => $v) {
+                $list = $list && is_int($k);
+                $shape[$k] = self::shapeOf($v);
+            }
+            // the number of values in a list like `$in` doesn't matter
+            return $list ? array_values(array_unique($shape, SORT_REGULAR)) : $shape;
+        }
+        return 1;
+    }
+}
@@ -0,0 +1,136 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use MongoDB\Driver\Monitoring\CommandFailedEvent;
+use MongoDB\Driver\Monitoring\CommandStartedEvent;
+use MongoDB\Driver\Monitoring\CommandSucceededEvent;
+
+/**
+ * Records every command the driver sends into a `Profiler`.
+ *
+ * This requires a driver with the monitoring API; use
+ * `Profiler::subscribe`, which checks for it.
+ *
+ * @since 0.8.0
+ */
+class ProfilerSubscriber implements \MongoDB\Driver\Monitoring\CommandSubscriber
+{
+    /**
+     * The collection and criteria of commands in progress, by request ID
+     */
+    private Map<string,(string,mixed)> $started = Map{};
+
+    /**
+     * Creates a new ProfilerSubscriber.
+     *
+     * @param $profiler - The profiler to fill
+     * @param $namespace - Optional database name, or database and collection
+     *        name, to record commands for; others are ignored
+     */
+    public function __construct(private Profiler $profiler, private ?string $namespace = null)
+    {
+    }
+
+    /**
+     * Adds a new subscriber for a profiler to the driver.
+     *
+     * @param $profiler - The profiler to fill
+     * @param $namespace - Optional database name, or database and collection
+     *        name, to record commands for
+     * @return - The subscriber added
+     */
+    public static function register(Profiler $profiler, ?string $namespace = null): ProfilerSubscriber
+    {
+        $subscriber = new self($profiler, $namespace);
+        \MongoDB\Driver\Monitoring\addSubscriber($subscriber);
+        return $subscriber;
+    }
+
+    /**
+     * Removes this subscriber from the driver.
+     */
+    public function unregister(): void
+    {
+        \MongoDB\Driver\Monitoring\removeSubscriber($this);
+        $this->started->clear();
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function commandStarted(CommandStartedEvent $event): void
+    {
+        $name = $event->getCommandName();
+        $command = $event->getCommand();
+        $collection = $name === 'getMore' ?
+            ($command->collection ?? '') : ($command->$name ?? '');
+        $collection = is_string($collection) ? $collection : '';
+        $namespace = $this->namespace;
+        if ($namespace !== null) {
+            $db = $event->getDatabaseName();
+            if ($namespace !== $db && $namespace !== "$db.$collection") {
+                return;
+            }
+        }
+        $criteria = $command->filter ?? $command->query ?? $command->pipeline ??
+            $command->updates[0]->q ?? $command->deletes[0]->q ?? null;
+        $this->started[$event->getRequestId()] = tuple($collection, $criteria);
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function commandSucceeded(CommandSucceededEvent $event): void
+    {
+        $reply = $event->getReply();
+        $batch = $reply->cursor->firstBatch ?? $reply->cursor->nextBatch ?? null;
+        $documents = $batch === null ? (int) ($reply->n ?? 0) : count($batch);
+        $this->finish($event->getRequestId(), $event->getCommandName(), $event->getDurationMicros(), $documents);
+    }
+
+    /**
+     * {@inheritDoc}
+     */
+    public function commandFailed(CommandFailedEvent $event): void
+    {
+        $this->finish($event->getRequestId(), $event->getCommandName(), $event->getDurationMicros(), 0);
+    }
+
+    /**
+     * Records a finished command.
+     *
+     * @param $requestId - The request ID
+     * @param $name - The command name
+     * @param $micros - The duration in microseconds
+     * @param $documents - The number of documents returned or written
+     */
+    private function finish(string $requestId, string $name, int $micros, int $documents): void
+    {
+        $started = $this->started->get($requestId);
+        if ($started === null) {
+            // filtered out, or started before this subscriber was added
+            return;
+        }
+        list($collection, $criteria) = $started;
+        $this->started->removeKey($requestId);
+        $this->profiler->record($collection, $name, $criteria, $micros / 1000, $documents);
+    }
+}
@@ -0,0 +1,126 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use MongoDB\Driver\ReadPreference;
+
+/**
+ * Sends reads to secondaries, except right after a write.
+ *
+ * Reads go to a secondary which is at most `maxStalenessSeconds` behind the
+ * primary. For `pinSeconds` after a write, reads go to the primary instead so
+ * users see their own changes. The time of the last write can be kept in a
+ * store which outlives the request, such as the values of a user's session,
+ * so the next request is pinned too.
+ *
+ * One ReadRouter can be shared by every DAO, so a write to one collection
+ * pins reads from all of them.
+ *
+ * ```hack
+ * $router = new ReadRouter(90, 120, $session->getValues('Labrys\Db'));
+ * $dao = new MyDao($manager, 'db.coll', Map{'readRouter' => $router});
+ * ```
+ *
+ * @since 0.8.0
+ */
+class ReadRouter
+{
+    /**
+     * The store key for the time of the last write
+     */
+    const string LAST_WRITE = 'lastWrite';
+
+    private float $lastWrite = 0.0;
+    private int $pinSeconds;
+    private ReadPreference $primary;
+    private ReadPreference $secondary;
+
+    /**
+     * Creates a new ReadRouter.
+     *
+     * @param $maxStalenessSeconds - How far behind the primary a secondary can
+     *        be; MongoDB requires at least 90
+     * @param $pinSeconds - How long reads go to the primary after a write,
+     *        by default `$maxStalenessSeconds`
+     * @param $store - Optional place to keep the time of the last write
+     * @throws \InvalidArgumentException if either number of seconds is too low
+     */
+    public function __construct(
+        int $maxStalenessSeconds = 90,
+        ?int $pinSeconds = null,
+        private ?\ArrayAccess<string,mixed> $store = null,
+    ) {
+        if ($maxStalenessSeconds < 90) {
+            throw new \InvalidArgumentException("maxStalenessSeconds must be at least 90");
+        }
+        $this->pinSeconds = $pinSeconds ?? $maxStalenessSeconds;
+        if ($this->pinSeconds < 0) {
+            throw new \InvalidArgumentException("pinSeconds cannot be negative");
+        }
+        $this->primary = new ReadPreference(ReadPreference::RP_PRIMARY);
+        $this->secondary = new ReadPreference(
+            ReadPreference::RP_SECONDARY_PREFERRED,
+            null,
+            ['maxStalenessSeconds' => $maxStalenessSeconds]
+        );
+        if ($store !== null && $store->offsetExists(self::LAST_WRITE)) {
+            $this->lastWrite = (float) $store->offsetGet(self::LAST_WRITE);
+        }
+    }
+
+    /**
+     * Notes that a write just happened, pinning reads to the primary.
+     */
+    public function recordWrite(): void
+    {
+        $this->lastWrite = microtime(true);
+        $this->store?->offsetSet(self::LAST_WRITE, $this->lastWrite);
+    }
+
+    /**
+     * Gets the time of the last write.
+     *
+     * @return - The Unix timestamp with microseconds, or 0 if none
+     */
+    public function getLastWrite(): float
+    {
+        return $this->lastWrite;
+    }
+
+    /**
+     * Whether reads are going to the primary because of a recent write.
+     *
+     * @return - Whether reads are pinned
+     */
+    public function isPinned(): bool
+    {
+        return microtime(true) - $this->lastWrite < $this->pinSeconds;
+    }
+
+    /**
+     * Gets the read preference for the next read.
+     *
+     * @return - The primary if pinned, otherwise a bounded-staleness secondary
+     */
+    public function getReadPreference(): ReadPreference
+    {
+        return $this->isPinned() ? $this->primary : $this->secondary;
+    }
+}
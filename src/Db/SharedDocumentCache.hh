@@ -0,0 +1,166 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+/**
+ * A cross-request document cache stored in APC shared memory.
+ *
+ * Documents are stored as BSON under a key made of the namespace, the
+ * identifier, and the document version. A second key per identifier points to
+ * the latest known version, so invalidating a document is a single delete and
+ * an older version can never replace a newer one.
+ *
+ * A copy is never replaced by one with the same version, since the two can't
+ * be told apart; this is always the case for unversioned documents. After an
+ * invalidation, nothing is stored for the document during a short hold-off,
+ * so a copy read before a write can't be put back by a slower request.
+ *
+ * @since 0.8.0
+ */
+class SharedDocumentCache
+{
+    /**
+     * Creates a new SharedDocumentCache.
+     *
+     * @param $namespace - The namespace, usually the collection name
+     * @param $ttl - The number of seconds a document lives (0 for no expiry)
+     * @param $prefix - The prefix for all APC keys
+     * @param $holdoff - The number of seconds nothing is stored for a document after it's invalidated
+     */
+    public function __construct(
+        private string $namespace,
+        private int $ttl = 300,
+        private string $prefix = 'labrys',
+        private int $holdoff = 5,
+    ) {
+    }
+
+    /**
+     * Gets a cached BSON document.
+     *
+     * @param $id - The document identifier
+     * @return - The BSON document, or `null` if not cached
+     */
+    public function fetch(string $id): ?string
+    {
+        return $this->fetchAll(ImmVector{$id})[$id] ?? null;
+    }
+
+    /**
+     * Gets several cached BSON documents.
+     *
+     * @param $ids - The document identifiers
+     * @return - The BSON documents found, keyed by identifier
+     */
+    public function fetchAll(\ConstVector<string> $ids): ImmMap<string,string>
+    {
+        $found = Map{};
+        if ($ids->isEmpty()) {
+            return $found->toImmMap();
+        }
+        $pointers = apc_fetch($ids->map($id ==> $this->key($id))->toArray());
+        if (!is_array($pointers) || count($pointers) === 0) {
+            return $found->toImmMap();
+        }
+        $keys = Map{};
+        foreach ($ids as $id) {
+            $version = $pointers[$this->key($id)] ?? null;
+            if ($version !== null) {
+                $keys[$this->key($id, (int) $version)] = $id;
+            }
+        }
+        $docs = apc_fetch($keys->keys()->toArray());
+        if (is_array($docs)) {
+            foreach ($docs as $k => $doc) {
+                $found[$keys[$k]] = (string) $doc;
+            }
+        }
+        return $found->toImmMap();
+    }
+
+    /**
+     * Stores a BSON document.
+     *
+     * Nothing happens if the same or a newer version of the document is
+     * already known, or if it was invalidated within the hold-off. The
+     * pointer to the current version only moves forward, so a process storing
+     * an older copy can't replace a newer one stored at the same time.
+     *
+     * @param $id - The document identifier
+     * @param $version - The document version
+     * @param $bson - The BSON document
+     */
+    public function store(string $id, int $version, string $bson): void
+    {
+        $pointer = $this->key($id);
+        if (apc_exists("$pointer:stale")) {
+            return;
+        }
+        $current = apc_fetch($pointer);
+        if ($current !== false && (int) $current >= $version) {
+            return;
+        }
+        apc_store($this->key($id, $version), $bson, $this->ttl);
+        do {
+            if ($current === false) {
+                $stored = apc_add($pointer, $version, $this->ttl);
+            } elseif ((int) $current < $version) {
+                $stored = apc_cas($pointer, (int) $current, $version);
+            } else {
+                return;
+            }
+            if (!$stored) {
+                $current = apc_fetch($pointer);
+            }
+        } while (!$stored);
+        // an invalidation may have come in while this was stored
+        if (apc_exists("$pointer:stale")) {
+            apc_delete($pointer);
+        }
+    }
+
+    /**
+     * Removes a document from the cache.
+     *
+     * Call this both before and after writing the document.
+     *
+     * @param $id - The document identifier
+     */
+    public function invalidate(string $id): void
+    {
+        if ($this->holdoff > 0) {
+            apc_store($this->key($id) . ':stale', true, $this->holdoff);
+        }
+        apc_delete($this->key($id));
+    }
+
+    /**
+     * Gets the APC key for a document.
+     *
+     * @param $id - The document identifier
+     * @param $version - The version, or `null` for the pointer key
+     * @return - The APC key
+     */
+    private function key(string $id, ?int $version = null): string
+    {
+        $key = "{$this->prefix}:{$this->namespace}:$id";
+        return $version === null ? $key : "$key:$version";
+    }
+}
@@ -0,0 +1,198 @@
+<?hh // strict
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2017 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use MongoDB\BSON\ObjectID;
+use MongoDB\BSON\Persistable;
+use MongoDB\Driver\WriteResult;
+
+/**
+ * Collects inserts, updates, and deletes, then flushes them per collection.
+ *
+ * ```hack
+ * $uow = new UnitOfWork();
+ * $uow->update($userDao, $user)
+ *     ->update($userDao, $otherUser)
+ *     ->persist($auditDao, $entry)
+ *     ->flush();
+ * ```
+ *
+ * Each DAO receives one bulk write containing all of its operations. Changes
+ * of `Modifiable` entities are read when the unit is flushed, not when they
+ * are registered.
+ *
+ * @since 0.8.0
+ */
+class UnitOfWork
+{
+    /**
+     * The participating DAOs, in the order they were first used
+     */
+    private Map<string,BulkWritable> $daos = Map{};
+    /**
+     * Documents to insert, by DAO
+     */
+    private Map<string,Vector<Persistable>> $inserts = Map{};
+    /**
+     * Entities to update, by DAO then by object
+     */
+    private Map<string,Map<string,Entity\Modifiable>> $updates = Map{};
+    /**
+     * Entities to delete, by DAO then by object
+     */
+    private Map<string,Map<string,mixed>> $deletes = Map{};
+
+    /**
+     * Creates a new UnitOfWork.
+     *
+     * @param $ordered - Whether each bulk write runs in order and stops at
+     *        the first error
+     */
+    public function __construct(private bool $ordered = true)
+    {
+    }
+
+    /**
+     * Registers a document for insertion.
+     *
+     * @param $dao - The DAO which will write the document
+     * @param $entity - The document to insert
+     * @return - provides a fluent interface
+     */
+    public function persist(BulkWritable $dao, Persistable $entity): this
+    {
+        $key = $this->register($dao);
+        $this->inserts[$key][] = $entity;
+        return $this;
+    }
+
+    /**
+     * Registers an entity whose changes will be written.
+     *
+     * @param $dao - The DAO which will write the changes
+     * @param $entity - The entity to update
+     * @return - provides a fluent interface
+     */
+    public function update(BulkWritable $dao, Entity\Modifiable $entity): this
+    {
+        $key = $this->register($dao);
+        $this->updates[$key][spl_object_hash($entity)] = $entity;
+        return $this;
+    }
+
+    /**
+     * Registers an entity for removal.
+     *
+     * Anything other than an entity object is taken as the identifier.
+     *
+     * @param $dao - The DAO which will delete the entity
+     * @param $entity - The entity to delete, or its identifier
+     * @return - provides a fluent interface
+     */
+    public function delete(BulkWritable $dao, mixed $entity): this
+    {
+        $key = $this->register($dao);
+        $hash = is_object($entity) && !($entity instanceof ObjectID) ?
+            spl_object_hash($entity) : 'id:' . (string) $entity;
+        $this->deletes[$key][$hash] = $entity;
+        return $this;
+    }
+
+    /**
+     * Whether any operations are waiting to be flushed.
+     *
+     * @return - Whether the unit has pending work
+     */
+    public function isPending(): bool
+    {
+        return !$this->daos->isEmpty();
+    }
+
+    /**
+     * Sends one bulk write per DAO.
+     *
+     * Operations for a DAO are forgotten once its write succeeds; if a write
+     * fails, it and any following DAOs remain pending.
+     *
+     * @return - The results of each bulk write that had something to do
+     * @throws \Caridea\Dao\Exception\Unreachable If the connection fails
+     * @throws \Caridea\Dao\Exception\Violating If a constraint is violated
+     * @throws \Caridea\Dao\Exception\Generic If any other database problem occurs
+     */
+    public function flush(): ImmVector<WriteResult>
+    {
+        $results = Vector{};
+        foreach ($this->daos->toImmMap() as $key => $dao) {
+            $wr = $dao->writeBulk(
+                $this->inserts[$key],
+                $this->updates[$key]->values(),
+                $this->deletes[$key]->values(),
+                $this->ordered
+            );
+            if ($wr !== null) {
+                $results[] = $wr;
+            }
+            $this->forget($key);
+        }
+        return $results->toImmVector();
+    }
+
+    /**
+     * Forgets all pending operations.
+     */
+    public function clear(): void
+    {
+        $this->daos->clear();
+        $this->inserts->clear();
+        $this->updates->clear();
+        $this->deletes->clear();
+    }
+
+    /**
+     * Adds a DAO to the participants.
+     *
+     * @param $dao - The DAO
+     * @return - The key for the DAO
+     */
+    private function register(BulkWritable $dao): string
+    {
+        $key = spl_object_hash($dao);
+        if (!$this->daos->containsKey($key)) {
+            $this->daos[$key] = $dao;
+            $this->inserts[$key] = Vector{};
+            $this->updates[$key] = Map{};
+            $this->deletes[$key] = Map{};
+        }
+        return $key;
+    }
+
+    /**
+     * Removes a DAO and its operations.
+     *
+     * @param $key - The key for the DAO
+     */
+    private function forget(string $key): void
+    {
+        $this->daos->removeKey($key);
+        $this->inserts->removeKey($key);
+        $this->updates->removeKey($key);
+        $this->deletes->removeKey($key);
+    }
+}
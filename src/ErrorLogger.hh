@@ -56,6 +56,18 @@ class ErrorLogger implements \Psr\Log\LoggerAwareInterface
         $this->levels = $levels ? $levels->toImmMap() : ImmMap{};
     }
 
+    /**
+     * Gets the logger, for others who log to the same place.
+     *
+     * @return - The logger
+     * @since 0.8.0
+     */
+    public function getLogger(): Logger
+    {
+        /* HH_IGNORE_ERROR[4110]: This isn't null, we set it in the constructor */
+        return $this->logger;
+    }
+
     /**
      * Logs an exception.
      *
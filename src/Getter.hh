@@ -26,9 +26,21 @@ namespace Labrys;
  */
 class Getter
 {
+    /**
+     * Accessors for the ID of each class
+     */
+    private static Map<string,(function(mixed): mixed)> $idAccessors = Map{};
+    /**
+     * Accessors for fields of each class, keyed by class then field name
+     */
+    private static Map<string,Map<string,(function(mixed): mixed)>> $accessors = Map{};
+
     /**
      * Gets the MongoDB-style ID from an object.
      *
+     * How the ID is read is worked out once per class and remembered, except
+     * for `stdClass`, whose properties can differ per instance.
+     *
      * @param $object - The object
      * @return - The ID found or `null`
      */
@@ -36,20 +48,16 @@ class Getter
     {
         if ($object instanceof KeyedContainer) {
             return $object['_id'] ?? null;
+        } elseif ($object instanceof \stdClass) {
+            return $object->_id ?? $object->id ?? null;
         } elseif (is_object($object)) {
-            $values = get_object_vars($object);
-            invariant($values !== null, 'The values array is null');
-            if (array_key_exists('_id', $values)) {
-                return $values['_id'];
-            } elseif (array_key_exists('id', $values)) {
-                return $values['id'];
-            } elseif (method_exists($object, 'getId') || method_exists($object, '__call')) {
-                /* HH_IGNORE_ERROR[4062]: We checked */
-                return $object->getId();
-            } elseif (method_exists($object, '__get')) {
-                /* HH_IGNORE_ERROR[4062]: We checked */
-                return $object->id;
+            $class = get_class($object);
+            $accessor = self::$idAccessors[$class] ?? null;
+            if ($accessor === null) {
+                $accessor = self::compileId(new \ReflectionClass($class));
+                self::$idAccessors[$class] = $accessor;
             }
+            return $accessor($object);
         }
         return null;
     }
@@ -57,6 +65,9 @@ class Getter
     /**
      * Extracts any field from an object.
      *
+     * How the field is read is worked out once per class and remembered,
+     * except for `stdClass`, whose properties can differ per instance.
+     *
      * @param $object - The object
      * @return - The value found or `null`
      */
@@ -64,18 +75,120 @@ class Getter
     {
         if ($object instanceof KeyedContainer) {
             return $object[$field] ?? null;
+        } elseif ($object instanceof \stdClass) {
+            return $object->$field ?? null;
         } elseif (is_object($object)) {
-            $values = get_object_vars($object);
-            invariant($values !== null, 'The values array is null');
-            if (array_key_exists($field, $values)) {
-                return $values[$field];
-            } elseif (method_exists($object, 'get' . ucfirst($field)) || method_exists($object, '__call')) {
-                return call_user_func([$object, 'get' . ucfirst($field)]);
-            } elseif (method_exists($object, '__get')) {
-                /* HH_IGNORE_ERROR[4062]: We checked */
-                return $object->id;
+            $class = get_class($object);
+            $accessor = self::$accessors[$class][$field] ?? null;
+            if ($accessor === null) {
+                if (!self::$accessors->containsKey($class)) {
+                    self::$accessors[$class] = Map{};
+                }
+                $accessor = self::compile(new \ReflectionClass($class), $field);
+                self::$accessors[$class][$field] = $accessor;
             }
+            return $accessor($object);
         }
         return null;
     }
+
+    /**
+     * Works out how to read the ID of a class.
+     *
+     * @param $rc - The class
+     * @return - The accessor
+     */
+    private static function compileId(\ReflectionClass $rc): (function(mixed): mixed)
+    {
+        if (self::usesTrait($rc, \Labrys\Db\Entity\Identified::class)) {
+            return $o ==> $o->getId();
+        } elseif (self::isPublicProperty($rc, '_id')) {
+            return $o ==> $o->_id;
+        } elseif (self::isPublicProperty($rc, 'id')) {
+            return $o ==> $o->id;
+        } elseif ($rc->hasMethod('getId') || $rc->hasMethod('__call')) {
+            $accessor = $o ==> $o->getId();
+        } elseif ($rc->hasMethod('__get')) {
+            $accessor = $o ==> $o->id;
+        } else {
+            $accessor = $o ==> null;
+        }
+        return self::withDynamic($rc, '_id', self::withDynamic($rc, 'id', $accessor));
+    }
+
+    /**
+     * Works out how to read a field of a class.
+     *
+     * @param $rc - The class
+     * @param $field - The field name
+     * @return - The accessor
+     */
+    private static function compile(\ReflectionClass $rc, string $field): (function(mixed): mixed)
+    {
+        $getter = 'get' . ucfirst($field);
+        if (self::isPublicProperty($rc, $field)) {
+            return $o ==> $o->$field;
+        } elseif ($rc->hasMethod($getter) || $rc->hasMethod('__call')) {
+            $accessor = $o ==> $o->$getter();
+        } elseif ($rc->hasMethod('__get')) {
+            $accessor = $o ==> $o->$field;
+        } else {
+            $accessor = $o ==> null;
+        }
+        return self::withDynamic($rc, $field, $accessor);
+    }
+
+    /**
+     * Makes an accessor read a dynamic property first, if one can exist.
+     *
+     * A property that isn't declared can still be set on any instance, so it
+     * is checked on each call, like `get_object_vars` did before accessors
+     * were compiled.
+     *
+     * @param $rc - The class
+     * @param $name - The property name
+     * @param $accessor - The accessor to use when there's no such property
+     * @return - The accessor
+     */
+    private static function withDynamic(\ReflectionClass $rc, string $name, (function(mixed): mixed) $accessor): (function(mixed): mixed)
+    {
+        if ($rc->hasProperty($name)) {
+            return $accessor;
+        }
+        return $o ==> property_exists($o, $name) ? $o->$name : $accessor($o);
+    }
+
+    /**
+     * Whether a class has a public instance property.
+     *
+     * @param $rc - The class
+     * @param $name - The property name
+     * @return - Whether the property is public and not static
+     */
+    private static function isPublicProperty(\ReflectionClass $rc, string $name): bool
+    {
+        if (!$rc->hasProperty($name)) {
+            return false;
+        }
+        $rp = $rc->getProperty($name);
+        return $rp->isPublic() && !$rp->isStatic();
+    }
+
+    /**
+     * Whether a class or any of its parents use a trait.
+     *
+     * @param $rc - The class
+     * @param $trait - The trait name
+     * @return - Whether the trait is used
+     */
+    private static function usesTrait(\ReflectionClass $rc, string $trait): bool
+    {
+        do {
+            if (in_array($trait, $rc->getTraitNames(), true)) {
+                return true;
+            }
+            $rc = $rc->getParentClass();
+        } while ($rc);
+        return false;
+    }
 }
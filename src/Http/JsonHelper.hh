@@ -43,27 +43,116 @@ trait JsonHelper
     /**
      * Sends a Content-Range header for pagination
      *
+     * The items are encoded and written to the body one at a time, so a
+     * `Labrys\Db\CursorSubset` is never buffered in full. For a
+     * `Labrys\Db\KeysetSubset`, an `X-Next-Cursor` header with the token
+     * of the next page is sent instead, if there is a next page.
+     *
      * @param $response - The response
      * @return - The JSON response
      * @since 0.6.0
      */
     protected function sendItems<T>(Response $response, Traversable<T> $items, ?Pagination $pagination = null, ?int $total = null): Response
     {
-        if ($items instanceof \Labrys\Db\CursorSubset) {
-            $total = $items->getTotal();
-            $items = new Vector($items);
+        $count = $this->writeJsonArray($response, self::encodeEach($items));
+        return $this->withItemHeaders($response, $items, $count, $pagination, $total);
+    }
+
+    /**
+     * Sends items which are already encoded as JSON, like those from
+     * `Labrys\Db\JsonRepo::findJson`, as a JSON array.
+     *
+     * The items are written to the body one at a time. A Content-Range header
+     * or an `X-Next-Cursor` header is sent just like `sendItems`.
+     *
+     * @param $response - The response
+     * @param $items - The JSON of each item
+     * @param $pagination - Optional pagination parameters
+     * @param $total - The total number of items, if `$items` doesn't know it
+     * @return - The JSON response
+     * @since 0.8.0
+     */
+    protected function sendJsonItems(Response $response, Traversable<string> $items, ?Pagination $pagination = null, ?int $total = null): Response
+    {
+        $count = $this->writeJsonArray($response, $items);
+        return $this->withItemHeaders($response, $items, $count, $pagination, $total);
+    }
+
+    /**
+     * Adds the headers for a list of items that has been written.
+     *
+     * The total comes from a `Labrys\Db\CursorSubset` if possible, then from
+     * `$total`, then from the number of items written.
+     *
+     * @param $response - The response
+     * @param $items - The items written
+     * @param $count - The number of items written
+     * @param $pagination - Optional pagination parameters
+     * @param $total - The total number of items, if `$items` doesn't know it
+     * @return - The JSON response
+     */
+    private function withItemHeaders<T>(Response $response, Traversable<T> $items, int $count, ?Pagination $pagination, ?int $total): Response
+    {
+        if ($items instanceof \Labrys\Db\KeysetSubset) {
+            $next = $items->getNextToken();
+            if ($next !== null) {
+                $response = $response->withHeader('X-Next-Cursor', $next);
+            }
         } else {
-            $items = new Vector($items);
-            $total = $total ?? count($items);
+            $total = $items instanceof \Labrys\Db\CursorSubset ?
+                $items->getTotal() : ($total ?? $count);
+            $response = $this->withContentRange($response, $pagination, $total);
+        }
+        return $response->withHeader('Content-Type', 'application/json');
+    }
+
+    /**
+     * Lazily encodes items as JSON.
+     *
+     * @param $items - The items
+     * @return - The JSON of each item
+     */
+    private static function encodeEach<T>(Traversable<T> $items): \Generator<int,string,void>
+    {
+        foreach ($items as $item) {
+            yield json_encode($item);
         }
+    }
+
+    /**
+     * Writes JSON items to the response body as a JSON array.
+     *
+     * @param $response - The response
+     * @param $items - The JSON of each item
+     * @return - The number of items written
+     */
+    private function writeJsonArray(Response $response, Traversable<string> $items): int
+    {
+        $body = $response->getBody();
+        $count = 0;
+        $body->write('[');
+        foreach ($items as $item) {
+            $body->write($count++ === 0 ? $item : ",$item");
+        }
+        $body->write(']');
+        return $count;
+    }
+
+    /**
+     * Adds a Content-Range header for a page of items.
+     *
+     * @param $response - The response
+     * @param $pagination - Optional pagination parameters
+     * @param $total - The total number of items
+     * @return - The response with the header
+     */
+    private function withContentRange(Response $response, ?Pagination $pagination, int $total): Response
+    {
         $start = $pagination?->getOffset() ?? 0;
         $max = $pagination?->getMax() ?? 0;
         // make sure $end is no higher than $total and isn't negative
         $end = max(min((PHP_INT_MAX - $max < $start ? PHP_INT_MAX : $start + $max), $total) - 1, 0);
-        return $this->sendJson(
-            $response->withHeader('Content-Range', "items $start-$end/$total"),
-            $items
-        );
+        return $response->withHeader('Content-Range', "items $start-$end/$total");
     }
 
     /**
@@ -39,6 +39,11 @@ class Service implements \Caridea\Container\ContainerAware
      */
     private ?BlockLayout $blocks;
 
+    /**
+     * The stored DbRef registry
+     */
+    private ?\Labrys\Db\DbRefRegistry $dbRefRegistry;
+
     /**
      * List of statuses
      */
@@ -270,6 +275,22 @@ class Service implements \Caridea\Container\ContainerAware
         return new ImmVector($this->container->getByType(\Labrys\Db\DbRefResolver::class));
     }
 
+    /**
+     * Gets a registry of the `Labrys\Db\DbRefResolver` objects in the container.
+     *
+     * The registry can resolve DbRefs of several types at once.
+     *
+     * @return - The DbRef registry (created lazily)
+     * @since 0.8.0
+     */
+    public function getDbRefRegistry(): \Labrys\Db\DbRefRegistry
+    {
+        if ($this->dbRefRegistry === null) {
+            $this->dbRefRegistry = new \Labrys\Db\DbRefRegistry($this->getDbRefResolvers());
+        }
+        return $this->dbRefRegistry;
+    }
+
     /**
      * Gets any `Labrys\View\EntityLinker` objects in the container.
      *
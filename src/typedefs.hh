@@ -25,3 +25,132 @@ namespace Labrys\Db;
  * @since 0.6.0
  */
 type DbRef = shape('$ref' => string, '$id' => mixed);
+
+/**
+ * Statistics about a first-level entity cache.
+ *
+ * @since 0.8.0
+ */
+type CacheStats = shape(
+    'hits' => int,
+    'misses' => int,
+    'evictions' => int,
+    'entries' => int,
+    'bytes' => int,
+);
+
+/**
+ * The outcome of one batch of a bulk insert or upsert.
+ *
+ * `failed` counts records with a write error, plus those never attempted
+ * because an ordered batch stopped early. `errors` holds the messages of the
+ * write errors, by position in the batch. `writeConcernError` holds the
+ * message if the writes weren't acknowledged as the write concern asked, in
+ * which case they may not be durable.
+ *
+ * @since 0.8.0
+ */
+type BulkReport = shape(
+    'count' => int,
+    'inserted' => int,
+    'upserted' => int,
+    'matched' => int,
+    'failed' => int,
+    'errors' => ImmMap<int,string>,
+    'writeConcernError' => ?string,
+);
+
+/**
+ * A MongoDB command recorded by `Labrys\Db\Profiler`.
+ *
+ * `shape` is the JSON of the criteria with every value replaced by `1`, so
+ * calls which differ only by their values share the same shape.
+ *
+ * @since 0.8.0
+ */
+type ProfiledCommand = shape(
+    'collection' => string,
+    'operation' => string,
+    'shape' => string,
+    'ms' => float,
+    'documents' => int,
+);
+
+/**
+ * A summary of the MongoDB commands in one request.
+ *
+ * `repeats` holds the number of calls by `collection operation shape` for
+ * those repeated often enough to suggest an N+1 query pattern.
+ *
+ * @since 0.8.0
+ */
+type ProfileSummary = shape(
+    'count' => int,
+    'ms' => float,
+    'cacheHits' => int,
+    'cacheMisses' => int,
+    'repeats' => ImmMap<string,int>,
+);
+
+/**
+ * A query which `Labrys\Db\IndexAdvisor` found no index for.
+ *
+ * `stage` is `COLLSCAN` when no index can narrow the criteria, or `SORT` when
+ * no index returns documents in the requested order. `callSite` is the file
+ * and line which called the DAO.
+ *
+ * @since 0.8.0
+ */
+type IndexFinding = shape(
+    'collection' => string,
+    'stage' => string,
+    'shape' => string,
+    'sort' => string,
+    'callSite' => string,
+);
+
+/**
+ * An index build in progress, as reported by `currentOp`.
+ *
+ * @since 0.8.0
+ */
+type IndexBuild = shape(
+    'opid' => mixed,
+    'message' => string,
+    'done' => int,
+    'total' => int,
+    'seconds' => int,
+);
+
+/**
+ * How much an index is used, from `$indexStats`.
+ *
+ * `ops` counts the operations which used the index since `since`, and
+ * `writes` the writes to the collection which had to maintain it since the
+ * server started. `status` is `used`, `negligible`, or `unused`.
+ * `constraint` is `unique` or `ttl` if the index does more than speed up
+ * queries, or `null`.
+ *
+ * @since 0.8.0
+ */
+type IndexUsage = shape(
+    'name' => string,
+    'declared' => bool,
+    'constraint' => ?string,
+    'ops' => int,
+    'since' => ?\DateTimeImmutable,
+    'bytes' => int,
+    'writes' => int,
+    'status' => string,
+);
+
+/**
+ * A pending increment of one field of one document.
+ *
+ * @since 0.8.0
+ */
+type CounterDelta = shape(
+    'id' => string,
+    'field' => string,
+    'amount' => int,
+);
@@ -0,0 +1,145 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class CounterBufferTest
+{
+    <<Test>>
+    public async function testIncrement(Assert $assert): Awaitable<void>
+    {
+        $object = new CounterBuffer(uniqid('test'), 3600, 3);
+        $object->flush($a ==> ImmSet{});
+        $assert->bool($object->increment('a:b', 'views'))->is(false);
+        $assert->bool($object->increment('a:b', 'views', 4))->is(false);
+        $assert->bool($object->increment('a', 'b:views'))->is(true);
+        $assert->int($object->getPending('a:b', 'views'))->eq(5);
+        $assert->int($object->getPending('a', 'b:views'))->eq(1);
+        $assert->int($object->getPending('a', 'views'))->eq(0);
+    }
+
+    <<Test>>
+    public async function testFlush(Assert $assert): Awaitable<void>
+    {
+        $object = new CounterBuffer(uniqid('test'), 3600);
+        $object->increment('a', 'views', 2);
+        $object->increment('b', 'views');
+        $written = Vector{};
+        $write = function (ImmVector<CounterDelta> $deltas) use ($written) {
+            $written->addAll($deltas);
+            return ImmSet{};
+        };
+        $assert->int($object->flush($write))->eq(2);
+        $assert->int($written->count())->eq(2);
+        $assert->mixed($written->map($a ==> $a['id'] . '=' . $a['amount'])->toArray())->looselyEquals(['a=2', 'b=1']);
+        $assert->int($object->getPending('a', 'views'))->eq(0);
+        $assert->int($object->flush($write))->eq(0);
+        $assert->int($written->count())->eq(2);
+    }
+
+    <<Test>>
+    public async function testFlushFailure(Assert $assert): Awaitable<void>
+    {
+        $object = new CounterBuffer(uniqid('test'), 3600);
+        $object->increment('a', 'views', 2);
+        $assert->whenCalled(function () use ($object) {
+            $object->flush(function (ImmVector<CounterDelta> $deltas) {
+                throw new \RuntimeException('Down');
+            });
+        })->willThrowClass(\RuntimeException::class);
+        $assert->int($object->getPending('a', 'views'))->eq(2);
+        $written = Vector{};
+        $assert->int($object->flush(function (ImmVector<CounterDelta> $deltas) use ($written) {
+            $written->addAll($deltas);
+            return ImmSet{};
+        }))->eq(1);
+        $assert->int($written->count())->eq(1);
+        $assert->int($written[0]['amount'])->eq(2);
+        $assert->int($object->getPending('a', 'views'))->eq(0);
+    }
+
+    <<Test>>
+    public async function testFlushRejected(Assert $assert): Awaitable<void>
+    {
+        $logger = new \ArrayObject();
+        $object = new CounterBuffer(uniqid('test'), 3600, 1000, 'labrys', new CounterBufferTestLogger($logger));
+        $object->increment('a', 'views');
+        $object->increment('b', 'title');
+        $assert->int($object->flush($a ==> ImmSet{1}))->eq(1);
+        $assert->int($object->getPending('b', 'title'))->eq(0);
+        $assert->int(count($logger))->eq(1);
+        $written = Vector{};
+        $assert->int($object->flush(function (ImmVector<CounterDelta> $deltas) use ($written) {
+            $written->addAll($deltas);
+            return ImmSet{};
+        }))->eq(0);
+        $assert->int($written->count())->eq(0);
+    }
+
+    <<Test>>
+    public async function testSweep(Assert $assert): Awaitable<void>
+    {
+        $namespace = uniqid('test');
+        $object = new CounterBuffer($namespace, 3600);
+        $write = $a ==> ImmSet{};
+        $object->increment('a', 'views');
+        $object->flush($write);
+        $assert->int((int) apc_fetch("labrys:counter:$namespace:swept"))->eq(0);
+        $object->flush($write);
+        $assert->int((int) apc_fetch("labrys:counter:$namespace:swept"))->eq(1);
+        $assert->mixed(apc_fetch("labrys:counter:$namespace:1:n"))->identicalTo(false);
+        $object->increment('a', 'views', 3);
+        $assert->int($object->getPending('a', 'views'))->eq(3);
+    }
+
+    <<Test>>
+    public async function testEvictedGeneration(Assert $assert): Awaitable<void>
+    {
+        $namespace = uniqid('test');
+        $object = new CounterBuffer($namespace, 3600);
+        $write = $a ==> ImmSet{};
+        $object->increment('a', 'views');
+        $object->flush($write);
+        $object->flush($write);
+        $object->flush($write);
+        $assert->int((int) apc_fetch("labrys:counter:$namespace:swept"))->eq(2);
+        apc_delete("labrys:counter:$namespace:gen");
+        $object->increment('a', 'views', 2);
+        $assert->int((int) apc_fetch("labrys:counter:$namespace:gen"))->eq(3);
+        $assert->int($object->getPending('a', 'views'))->eq(2);
+        apc_store("labrys:counter:$namespace:gen", 1);
+        $object->increment('a', 'views');
+        $assert->int((int) apc_fetch("labrys:counter:$namespace:gen"))->eq(3);
+        $assert->int($object->getPending('a', 'views'))->eq(3);
+    }
+}
+
+class CounterBufferTestLogger extends \Psr\Log\AbstractLogger
+{
+    public function __construct(private \ArrayObject $messages)
+    {
+    }
+
+    public function log($level, $message, array $context = [])
+    {
+        $this->messages[] = [$level, $message, $context];
+    }
+}
@@ -63,6 +63,21 @@ class CursorSubsetTest
         $assert->container($object->toArray())->isEmpty();
     }
 
+    <<Test>>
+    public async function testDeferred(Assert $assert): Awaitable<void>
+    {
+        $calls = Vector{};
+        $object = CursorSubset::deferred(Vector{'foo', 'bar'}, function () use ($calls) {
+            $calls[] = true;
+            return 7;
+        });
+        $assert->int($calls->count())->eq(0);
+        $assert->int($object->getTotal())->eq(7);
+        $assert->int($object->getTotal())->eq(7);
+        $assert->int($calls->count())->eq(1);
+        $assert->container($object->toArray())->containsOnly(['foo', 'bar']);
+    }
+
     <<Test>>
     public async function testException(Assert $assert): Awaitable<void>
     {
@@ -0,0 +1,114 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class DbRefRegistryTest
+{
+    <<Test>>
+    public async function testGetResolver(Assert $assert): Awaitable<void>
+    {
+        $users = new DbRefRegistryTestResolver('users', Map{});
+        $groups = new DbRefRegistryTestResolver('groups', Map{});
+        $object = new DbRefRegistry([$users, $groups]);
+        $assert->mixed($object->getResolver('users'))->identicalTo($users);
+        $assert->mixed($object->getResolver('groups'))->identicalTo($groups);
+        $assert->mixed($object->getResolver('posts'))->isNull();
+    }
+
+    <<Test>>
+    public async function testResolve(Assert $assert): Awaitable<void>
+    {
+        $users = new DbRefRegistryTestResolver('users', Map{'1' => ['_id' => '1', 'name' => 'foo']});
+        $object = new DbRefRegistry([$users]);
+        $assert->mixed($object->resolve(shape('$ref' => 'users', '$id' => '1')))
+            ->looselyEquals(['_id' => '1', 'name' => 'foo']);
+        $assert->mixed($object->resolve(shape('$ref' => 'users', '$id' => '2')))->isNull();
+    }
+
+    <<Test>>
+    public async function testResolveAll(Assert $assert): Awaitable<void>
+    {
+        $users = new DbRefRegistryTestResolver('users', Map{'1' => ['_id' => '1'], '2' => ['_id' => '2']});
+        $groups = new DbRefRegistryTestResolver('groups', Map{'1' => ['_id' => '1', 'group' => true]});
+        $object = new DbRefRegistry([$users, $groups]);
+        $resolved = $object->resolveAll([
+            shape('$ref' => 'users', '$id' => '2'),
+            shape('$ref' => 'groups', '$id' => '1'),
+            shape('$ref' => 'users', '$id' => '3'),
+            shape('$ref' => 'users', '$id' => '1'),
+        ]);
+        $assert->mixed($resolved->toArray())->looselyEquals([
+            ['_id' => '2'],
+            ['_id' => '1', 'group' => true],
+            null,
+            ['_id' => '1'],
+        ]);
+        // one call per reference type
+        $assert->int($users->calls)->eq(1);
+        $assert->int($groups->calls)->eq(1);
+    }
+
+    <<Test>>
+    public async function testMissing(Assert $assert): Awaitable<void>
+    {
+        $object = new DbRefRegistry([new DbRefRegistryTestResolver('users', Map{})]);
+        $assert->whenCalled(function () use ($object) {
+            $object->resolve(shape('$ref' => 'posts', '$id' => '1'));
+        })->willThrowClassWithMessage(\InvalidArgumentException::class, 'Unsupported reference type: posts');
+        $assert->whenCalled(function () use ($object) {
+            $object->resolveAll([shape('$ref' => 'users', '$id' => '1'), shape('$ref' => 'posts', '$id' => '1')]);
+        })->willThrowClassWithMessage(\InvalidArgumentException::class, 'Unsupported reference type: posts');
+    }
+}
+
+class DbRefRegistryTestResolver implements DbRefResolver<mixed>
+{
+    public int $calls = 0;
+
+    public function __construct(private string $type, private Map<string,mixed> $entities)
+    {
+    }
+
+    public function isResolvable(string $ref): bool
+    {
+        return $ref === $this->type;
+    }
+
+    public function resolve(DbRef $ref): mixed
+    {
+        $this->calls++;
+        return $this->entities[(string) $ref['$id']] ?? null;
+    }
+
+    public function resolveAll(Traversable<DbRef> $refs): Traversable<mixed>
+    {
+        $this->calls++;
+        $found = Vector{};
+        foreach ($refs as $ref) {
+            $entity = $this->entities[(string) $ref['$id']] ?? null;
+            if ($entity !== null) {
+                $found[] = $entity;
+            }
+        }
+        return $found;
+    }
+}
@@ -0,0 +1,142 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db\Entity;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class TrackingTest implements Modifiable
+{
+    use Tracking;
+
+    <<Test>>
+    public async function testSupersede(Assert $assert): Awaitable<void>
+    {
+        $object = new self();
+        $object->fieldSet('foo.bar', 1)
+            ->fieldSet('foo', 'baz')
+            ->fieldUnset('foo')
+            ->fieldIncrement('count')
+            ->fieldIncrement('count', 4);
+        $assert->mixed($this->toArray($object))->looselyEquals([
+            '$unset' => ['foo' => ''],
+            '$inc' => ['count' => 5],
+        ]);
+    }
+
+    <<Test>>
+    public async function testFold(Assert $assert): Awaitable<void>
+    {
+        $object = new self();
+        $object->fieldSet('tags', ['a', 'b'])
+            ->fieldPush('tags', 'c')
+            ->fieldPull('tags', 'a')
+            ->fieldSet('count', 2)
+            ->fieldIncrement('count', 3)
+            ->fieldPush('list', 1)
+            ->fieldPushAll('list', Vector{2, 3})
+            ->fieldPull('other', 'x')
+            ->fieldPull('other', 'y');
+        $assert->mixed($this->toArray($object))->looselyEquals([
+            '$set' => ['tags' => ['b', 'c'], 'count' => 5],
+            '$push' => ['list' => ['$each' => [1, 2, 3]]],
+            '$pull' => ['other' => ['$in' => ['x', 'y']]],
+        ]);
+    }
+
+    <<Test>>
+    public async function testAggregate(Assert $assert): Awaitable<void>
+    {
+        $child = new self();
+        $child->fieldSet('name', 'foo')->fieldIncrement('count');
+        $object = new self();
+        $object->fieldIncrement('child.count', 2)->aggregateChanges($child, 'child');
+        $assert->mixed($this->toArray($object))->looselyEquals([
+            '$inc' => ['child.count' => 3],
+            '$set' => ['child.name' => 'foo'],
+        ]);
+    }
+
+    <<Test>>
+    public async function testConflict(Assert $assert): Awaitable<void>
+    {
+        $assert->whenCalled(function () {
+            (new self())->fieldPull('tags', 'a')->fieldPush('tags', 'b');
+        })->willThrowClassWithMessage(\LogicException::class, 'Cannot combine $push with $pull for field: tags');
+    }
+
+    <<Test>>
+    public async function testPushModifiersAfterSet(Assert $assert): Awaitable<void>
+    {
+        $modifiers = [
+            ['$each' => ['c'], '$slice' => -2],
+            ['$each' => ['c'], '$sort' => 1],
+            ['$each' => ['c'], '$position' => 0],
+        ];
+        foreach ($modifiers as $value) {
+            $assert->whenCalled(function () use ($value) {
+                (new self())->fieldSet('tags', ['a', 'b'])->fieldChange('$push', 'tags', $value);
+            })->willThrowClassWithMessage(\LogicException::class, 'Cannot combine $push with $set for field: tags');
+        }
+    }
+
+    <<Test>>
+    public async function testPullConditionAfterSet(Assert $assert): Awaitable<void>
+    {
+        $assert->whenCalled(function () {
+            (new self())->fieldSet('scores', [1, 5, 9])->fieldPull('scores', ['$gte' => 5]);
+        })->willThrowClassWithMessage(\LogicException::class, 'Cannot combine $pull with $set for field: scores');
+        $assert->whenCalled(function () {
+            (new self())->fieldSet('docs', [['foo' => 'bar']])->fieldPull('docs', ['foo' => 'bar']);
+        })->willThrowClassWithMessage(\LogicException::class, 'Cannot combine $pull with $set for field: docs');
+    }
+
+    <<Test>>
+    public async function testPullNumberAfterSet(Assert $assert): Awaitable<void>
+    {
+        $object = (new self())->fieldSet('scores', [1, 2.0, 3, '2'])->fieldPull('scores', 2);
+        $assert->mixed($this->toArray($object)['$set']['scores'])->identicalTo([1, 3, '2']);
+        $assert->whenCalled(function () {
+            (new self())->fieldSet('refs', [new \MongoDB\BSON\ObjectID(), 'a'])->fieldPull('refs', 'a');
+        })->willThrowClassWithMessage(\LogicException::class, 'Cannot combine $pull with $set for field: refs');
+    }
+
+    <<Test>>
+    public async function testPullObjectIdAfterSet(Assert $assert): Awaitable<void>
+    {
+        $id = new \MongoDB\BSON\ObjectID();
+        $assert->whenCalled(function () use ($id) {
+            (new self())->fieldSet('refs', [$id])->fieldPull('refs', new \MongoDB\BSON\ObjectID((string) $id));
+        })->willThrowClassWithMessage(\LogicException::class, 'Cannot combine $pull with $set for field: refs');
+    }
+
+    public function bsonSerialize(): array
+    {
+        return [];
+    }
+
+    public function bsonUnserialize(array $data): void
+    {
+    }
+
+    private function toArray(Modifiable $object): array
+    {
+        return $object->getChanges()->map($a ==> $a->toArray())->toArray();
+    }
+}
@@ -0,0 +1,99 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+use MongoDB\BSON\ObjectID;
+use MongoDB\BSON\UTCDateTime;
+
+class HydratorGeneratorTest
+{
+    <<Test>>
+    public async function testRoundTrip(Assert $assert): Awaitable<void>
+    {
+        $class = 'HydratorGeneratorTestHydrator' . uniqid();
+        $object = new HydratorGenerator();
+        $code = $object->generate(HydratorGeneratorTestEntity::class, "Labrys\\Db\\Generated\\$class");
+        eval('?>' . $code);
+        $name = "Labrys\\Db\\Generated\\$class";
+        $hydrator = new $name();
+        $id = new ObjectID();
+        $document = [
+            '_id' => $id,
+            'name' => 'foo',
+            'tags' => ['a', 'b'],
+            'scores' => ['x' => 1, 'y' => 2],
+            'ranks' => [3, 1],
+            'created' => new UTCDateTime(1234567890123),
+            'changes' => ['$set' => ['name' => 'bar']],
+        ];
+        $entity = $hydrator->hydrate($document);
+        $assert->mixed($entity->getId())->identicalTo($id);
+        $assert->mixed($entity->tags)->looselyEquals(Vector{'a', 'b'});
+        $assert->mixed($entity->scores)->looselyEquals(Map{'x' => 1, 'y' => 2});
+        $assert->mixed($entity->ranks)->looselyEquals(ImmVector{3, 1});
+        $assert->string(get_class($entity->created))->is(\DateTimeImmutable::class);
+        $assert->string($entity->created?->format('U.u') ?? '')->is('1234567890.123000');
+        $assert->bool($entity->isDirty())->is(false);
+        $extracted = $hydrator->extract($entity);
+        unset($document['changes']);
+        $assert->mixed($extracted)->looselyEquals($document);
+        $assert->mixed($extracted)->looselyEquals($entity->bsonSerialize());
+        $copy = new HydratorGeneratorTestEntity();
+        $copy->bsonUnserialize($extracted);
+        $assert->mixed($hydrator->extract($copy))->looselyEquals($extracted);
+    }
+}
+
+class HydratorGeneratorTestEntity implements Entity\Modifiable
+{
+    use Entity\Identified;
+    use Entity\Tracking;
+
+    public string $name = '';
+    public Vector<string> $tags = Vector{};
+    public Map<string,int> $scores = Map{};
+    public ?ImmVector<int> $ranks;
+    public ?\DateTimeImmutable $created;
+
+    public function bsonSerialize(): array
+    {
+        return [
+            '_id' => $this->id,
+            'name' => $this->name,
+            'tags' => $this->tags->toValuesArray(),
+            'scores' => $this->scores->toArray(),
+            'ranks' => $this->ranks?->toValuesArray(),
+            'created' => $this->created === null ? null :
+                new UTCDateTime($this->created->getTimestamp() * 1000 + intdiv((int) $this->created->format('u'), 1000)),
+        ];
+    }
+
+    public function bsonUnserialize(array $data): void
+    {
+        $this->id = $data['_id'];
+        $this->name = (string) $data['name'];
+        $this->tags = new Vector($data['tags']);
+        $this->scores = new Map($data['scores']);
+        $this->ranks = $data['ranks'] === null ? null : new ImmVector($data['ranks']);
+        $this->created = $data['created'] instanceof UTCDateTime ?
+            \DateTimeImmutable::createFromMutable($data['created']->toDateTime()) : null;
+    }
+}
@@ -0,0 +1,73 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class IndexAdvisorTest
+{
+    private function getAdvisor(string $mode = IndexAdvisor::MODE_REPORT): IndexAdvisor
+    {
+        return new IndexAdvisor(Vector{
+            new MongoIndex(Map{'owner' => 1, 'created' => -1}),
+            new MongoIndex(Map{'name' => 1}),
+        }, $mode);
+    }
+
+    <<Test>>
+    public async function testAdviseFilter(Assert $assert): Awaitable<void>
+    {
+        $object = $this->getAdvisor();
+        $assert->int($object->advise(['owner' => 'a', 'status' => 'b'], ImmMap{})->count())->eq(0);
+        $assert->int($object->advise(['name' => ['$gt' => 'a']], ImmMap{})->count())->eq(0);
+        $assert->int($object->advise(['$or' => [['name' => 'a'], ['_id' => 1]]], ImmMap{})->count())->eq(0);
+        $assert->mixed($object->advise(['created' => 5], ImmMap{})->toArray())->looselyEquals(['COLLSCAN']);
+        $assert->mixed($object->advise(['$or' => [['name' => 'a'], ['status' => 1]]], ImmMap{})->toArray())->looselyEquals(['COLLSCAN']);
+    }
+
+    <<Test>>
+    public async function testAdviseSort(Assert $assert): Awaitable<void>
+    {
+        $object = $this->getAdvisor();
+        $assert->int($object->advise(['owner' => 'a'], ImmMap{'created' => false})->count())->eq(0);
+        $assert->int($object->advise(['owner' => 'a'], ImmMap{'created' => true})->count())->eq(0);
+        $assert->int($object->advise([], ImmMap{'owner' => false, 'created' => true})->count())->eq(0);
+        $assert->int($object->advise(['status' => 'a'], ImmMap{'name' => true})->count())->eq(0);
+        $assert->mixed($object->advise([], ImmMap{'owner' => true, 'created' => true})->toArray())->looselyEquals(['SORT']);
+        $assert->mixed($object->advise(['owner' => 'a'], ImmMap{'name' => true, 'created' => false})->toArray())->looselyEquals(['SORT']);
+        $assert->mixed($object->advise(['status' => 'a'], ImmMap{'created' => true})->toArray())->looselyEquals(['SORT', 'COLLSCAN']);
+        $assert->int($object->advise(['owner' => ['$in' => ['a']]], ImmMap{'created' => false})->count())->eq(0);
+        $assert->mixed($object->advise(['owner' => ['$in' => ['a', 'b']]], ImmMap{'created' => false})->toArray())->looselyEquals(['SORT']);
+    }
+
+    <<Test>>
+    public async function testCheckFail(Assert $assert): Awaitable<void>
+    {
+        $object = $this->getAdvisor(IndexAdvisor::MODE_FAIL);
+        $object->check('db.foo', ImmMap{'owner' => 'a'});
+        $assert->whenCalled(function () use ($object) {
+            $object->check('db.foo', ImmMap{'status' => 'a'});
+        })->willThrowClass(Exception\Unindexed::class);
+        $findings = $object->getFindings();
+        $assert->int($findings->count())->eq(1);
+        $assert->string($findings[0]['stage'])->is('COLLSCAN');
+        $assert->string($findings[0]['callSite'])->contains(__FILE__);
+    }
+}
@@ -0,0 +1,116 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class IndexPlanTest
+{
+    <<Test>>
+    public async function testToString(Assert $assert): Awaitable<void>
+    {
+        $index = new MongoIndex(Map{'owner' => 1, 'created' => -1}, null, ['unique' => true]);
+        $assert->string($index->getName())->is('owner_1_created_-1');
+        $object = new IndexPlan('db.foo', ImmVector{$index}, ImmSet{'old_1'}, ImmSet{'_id_'});
+        $assert->bool($object->isEmpty())->is(false);
+        $assert->string((string) $object)->is(implode(PHP_EOL, [
+            'Indexes for db.foo:',
+            '- old_1',
+            '+ owner_1_created_-1 {"key":{"owner":1,"created":-1},"unique":true}',
+            '= _id_',
+        ]));
+    }
+
+    <<Test>>
+    public async function testPlanUnusedIndexDrops(Assert $assert): Awaitable<void>
+    {
+        $usage = ImmVector{
+            self::usage('_id_', 'unused'),
+            self::usage('email_1', 'unused', false, 'unique'),
+            self::usage('expires_1', 'unused', false, 'ttl'),
+            self::usage('owner_1', 'unused', true),
+            self::usage('old_1', 'unused'),
+            self::usage('rare_1', 'negligible'),
+            self::usage('name_1', 'used'),
+        };
+        $object = new IndexPlanTestHelper();
+        $plan = $object->plan($usage, true);
+        $assert->mixed($plan->getDrop()->toArray())->looselyEquals(['old_1', 'rare_1']);
+        $assert->string((string) $plan)->is(implode(PHP_EOL, [
+            'Indexes for db.foo:',
+            '- old_1',
+            '- rare_1',
+            '= _id_ (primary key)',
+            '= email_1 (unique)',
+            '= expires_1 (ttl)',
+            '= owner_1 (declared)',
+            '= name_1 (used)',
+        ]));
+        $plan = $object->plan($usage, false);
+        $assert->mixed($plan->getDrop()->toArray())->looselyEquals(['old_1']);
+        $assert->string($plan->getReasons()['rare_1'])->is('negligible');
+    }
+
+    <<Test>>
+    public async function testIsSameIndex(Assert $assert): Awaitable<void>
+    {
+        $object = new IndexPlanTestHelper();
+        $declared = ['key' => ['name' => 1], 'collation' => ['locale' => 'fr', 'strength' => 2]];
+        $existing = [
+            'v' => 2,
+            'key' => ['name' => 1],
+            'name' => 'name_1',
+            'collation' => ['locale' => 'fr', 'caseLevel' => false, 'strength' => 2, 'numericOrdering' => false],
+        ];
+        $assert->bool($object->same($declared, $existing))->is(true);
+        $existing['collation']['strength'] = 3;
+        $assert->bool($object->same($declared, $existing))->is(false);
+        $assert->bool($object->same(['key' => ['name' => 1], 'unique' => true], $existing))->is(false);
+    }
+
+    private static function usage(string $name, string $status, bool $declared = false, ?string $constraint = null): IndexUsage
+    {
+        return shape(
+            'name' => $name,
+            'declared' => $declared,
+            'constraint' => $constraint,
+            'ops' => $status === 'unused' ? 0 : 10,
+            'since' => null,
+            'bytes' => 4096,
+            'writes' => 1000,
+            'status' => $status,
+        );
+    }
+}
+
+class IndexPlanTestHelper
+{
+    use MongoIndexHelper;
+
+    public function plan(Traversable<IndexUsage> $usage, bool $negligible): IndexPlan
+    {
+        return $this->planUnusedIndexDrops('db.foo', $usage, $negligible);
+    }
+
+    public function same(array<string,mixed> $declared, array<string,mixed> $existing): bool
+    {
+        return self::isSameIndex($declared, $existing);
+    }
+}
@@ -0,0 +1,101 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class KeysetPaginationTest
+{
+    <<Test>>
+    public async function testFirstPage(Assert $assert): Awaitable<void>
+    {
+        $object = new KeysetPagination(10, ['name' => false]);
+        $assert->int($object->getMax())->eq(10);
+        $assert->int($object->getOffset())->eq(0);
+        $assert->mixed($object->getOrder())->looselyEquals(['name' => false, '_id' => false]);
+        $assert->mixed($object->getAfter())->isNull();
+        $assert->mixed($object->toFilter())->isNull();
+    }
+
+    <<Test>>
+    public async function testToken(Assert $assert): Awaitable<void>
+    {
+        $first = new KeysetPagination(10, ['name' => true]);
+        $token = $first->getToken(['_id' => 5, 'name' => 'foo']);
+        $object = new KeysetPagination(10, ['name' => true], $token);
+        $assert->mixed($object->getAfter()?->toArray())->looselyEquals(['name' => 'foo', '_id' => 5]);
+        $assert->mixed($object->toFilter())->looselyEquals(['$or' => [
+            ['name' => ['$gt' => 'foo']],
+            ['name' => ['$eq' => 'foo'], '_id' => ['$gt' => 5]],
+        ]]);
+    }
+
+    <<Test>>
+    public async function testCraftedToken(Assert $assert): Awaitable<void>
+    {
+        $bson = \MongoDB\BSON\fromPHP(['name' => ['$ne' => null], '_id' => ['$exists' => true]]);
+        $token = rtrim(strtr(base64_encode($bson), '+/', '-_'), '=');
+        $assert->whenCalled(function () use ($token) {
+            new KeysetPagination(10, ['name' => true], $token);
+        })->willThrowClassWithMessage(\InvalidArgumentException::class, "Pagination token contains an operator");
+    }
+
+    <<Test>>
+    public async function testSignedToken(Assert $assert): Awaitable<void>
+    {
+        $first = new KeysetPagination(10, ['name' => true], null, 'secret');
+        $token = $first->getToken(['_id' => 5, 'name' => 'foo']);
+        $object = new KeysetPagination(10, ['name' => true], $token, 'secret');
+        $assert->mixed($object->getAfter()?->toArray())->looselyEquals(['name' => 'foo', '_id' => 5]);
+        $unsigned = (new KeysetPagination(10, ['name' => true]))->getToken(['_id' => 6, 'name' => 'bar']);
+        $assert->whenCalled(function () use ($unsigned) {
+            new KeysetPagination(10, ['name' => true], $unsigned, 'secret');
+        })->willThrowClassWithMessage(\InvalidArgumentException::class, "Invalid pagination token signature");
+        $assert->whenCalled(function () use ($token) {
+            new KeysetPagination(10, ['name' => true], $token, 'other');
+        })->willThrowClassWithMessage(\InvalidArgumentException::class, "Invalid pagination token signature");
+    }
+
+    <<Test>>
+    public async function testHiddenField(Assert $assert): Awaitable<void>
+    {
+        $object = new KeysetPagination(10, ['name' => true]);
+        $assert->whenCalled(function () use ($object) {
+            $object->getToken(new KeysetPaginationTestEntity('foo'));
+        })->willThrowClassWithMessage(\InvalidArgumentException::class, "Sort field 'name' can't be read from Labrys\\Db\\KeysetPaginationTestEntity");
+    }
+
+    <<Test>>
+    public async function testException(Assert $assert): Awaitable<void>
+    {
+        $assert->whenCalled(function () {
+            new KeysetPagination(10, [], 'not a token');
+        })->willThrowClassWithMessage(\InvalidArgumentException::class, "Invalid pagination token");
+    }
+}
+
+class KeysetPaginationTestEntity
+{
+    public mixed $_id = 5;
+
+    public function __construct(protected string $name)
+    {
+    }
+}
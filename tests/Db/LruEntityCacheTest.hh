@@ -0,0 +1,79 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class LruEntityCacheTest
+{
+    <<Test>>
+    public async function testGet(Assert $assert): Awaitable<void>
+    {
+        $object = new LruEntityCache();
+        $object->add('a', 'foo');
+        $object->add('a', 'bar');
+        $assert->mixed($object->get('a'))->identicalTo('foo');
+        $assert->mixed($object->get('b'))->isNull();
+        $object->set('a', 'bar');
+        $assert->mixed($object->get('a'))->identicalTo('bar');
+        $stats = $object->getStats();
+        $assert->int($stats['hits'])->eq(2);
+        $assert->int($stats['misses'])->eq(1);
+        $assert->int($stats['entries'])->eq(1);
+    }
+
+    <<Test>>
+    public async function testEvictEntries(Assert $assert): Awaitable<void>
+    {
+        $object = new LruEntityCache(2);
+        $object->add('a', 'foo');
+        $object->add('b', 'bar');
+        $object->get('a');
+        $object->add('c', 'baz');
+        $assert->bool($object->contains('a'))->is(true);
+        $assert->bool($object->contains('b'))->is(false);
+        $assert->bool($object->contains('c'))->is(true);
+        $assert->int($object->getStats()['evictions'])->eq(1);
+    }
+
+    <<Test>>
+    public async function testEvictBytes(Assert $assert): Awaitable<void>
+    {
+        $object = new LruEntityCache(0, 10, $a ==> strlen($a));
+        $object->add('a', 'abcd');
+        $object->add('b', 'efgh');
+        $object->add('c', 'ijkl');
+        $assert->bool($object->contains('a'))->is(false);
+        $assert->int($object->getStats()['bytes'])->eq(8);
+        $object->remove('b');
+        $assert->int($object->getStats()['bytes'])->eq(4);
+        $object->clear();
+        $assert->int($object->getStats()['entries'])->eq(0);
+        $assert->int($object->getStats()['bytes'])->eq(0);
+    }
+
+    <<Test>>
+    public async function testException(Assert $assert): Awaitable<void>
+    {
+        $assert->whenCalled(function () {
+            new LruEntityCache(-1);
+        })->willThrowClassWithMessage(\RangeException::class, "Cache limits cannot be negative");
+    }
+}
@@ -0,0 +1,59 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class PipelineTest
+{
+    <<Test>>
+    public async function testToArray(Assert $assert): Awaitable<void>
+    {
+        $object = (new Pipeline())
+            ->match(Map{'status' => 'active', 'tags' => Vector{'a', 'b'}})
+            ->unwind('tags')
+            ->group(['_id' => '$owner', 'total' => ['$sum' => 1]])
+            ->sort(['total' => false, 'name' => true])
+            ->skip(5)
+            ->limit(10);
+        $assert->mixed($object->toArray())->looselyEquals([
+            ['$match' => ['status' => 'active', 'tags' => ['a', 'b']]],
+            ['$unwind' => ['path' => '$tags', 'preserveNullAndEmptyArrays' => false]],
+            ['$group' => ['_id' => '$owner', 'total' => ['$sum' => 1]]],
+            ['$sort' => ['total' => -1, 'name' => 1]],
+            ['$skip' => 5],
+            ['$limit' => 10],
+        ]);
+    }
+
+    <<Test>>
+    public async function testIterator(Assert $assert): Awaitable<void>
+    {
+        $object = (new Pipeline())->lookup('users', 'owner', '_id', 'user')->count('n');
+        $stages = Vector{};
+        foreach ($object as $stage) {
+            $stages[] = $stage->toArray();
+        }
+        $assert->mixed($stages->toArray())->looselyEquals([
+            ['$lookup' => ['from' => 'users', 'localField' => 'owner', 'foreignField' => '_id', 'as' => 'user']],
+            ['$count' => 'n'],
+        ]);
+    }
+}
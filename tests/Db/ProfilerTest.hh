@@ -0,0 +1,92 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+use Mockery as M;
+
+class ProfilerTest
+{
+    <<Test>>
+    public async function testShapeOf(Assert $assert): Awaitable<void>
+    {
+        $a = Profiler::shapeOf(Map{'name' => 'foo', 'age' => Map{'$gt' => 3}, '_id' => ['$in' => [1, 2, 3]]});
+        $b = Profiler::shapeOf(['name' => 'bar', 'age' => ['$gt' => 9], '_id' => ['$in' => [4]]]);
+        $assert->string(json_encode($a))->is('{"name":1,"age":{"$gt":1},"_id":{"$in":[1]}}');
+        $assert->string(json_encode($b))->is(json_encode($a));
+    }
+
+    <<Test>>
+    public async function testSummary(Assert $assert): Awaitable<void>
+    {
+        $object = new Profiler(null, 100.0, 3);
+        for ($i = 0; $i < 3; $i++) {
+            $object->record('foo', 'find', ['_id' => $i], 2.0, 1);
+        }
+        $object->record('bar', 'find', ['_id' => 1], 2.0, 1);
+        $object->recordCache(true);
+        $object->recordCache(false);
+        $summary = $object->getSummary();
+        $assert->int($summary['count'])->eq(4);
+        $assert->float($summary['ms'])->eq(8.0);
+        $assert->int($summary['cacheHits'])->eq(1);
+        $assert->int($summary['cacheMisses'])->eq(1);
+        $assert->mixed($summary['repeats']->toArray())->looselyEquals(['foo find {"_id":1}' => 3]);
+    }
+
+    <<Test>>
+    public async function testSlow(Assert $assert): Awaitable<void>
+    {
+        $logger = M::mock(\Psr\Log\LoggerInterface::class);
+        $logger->shouldReceive('warning')->once();
+        $object = new Profiler($logger, 50.0);
+        $object->record('foo', 'find', null, 10.0);
+        $object->record('foo', 'find', null, 60.0);
+        $assert->int($object->getCommands()->count())->eq(2);
+        M::close();
+    }
+
+    <<Test>>
+    public async function testAddDocuments(Assert $assert): Awaitable<void>
+    {
+        $object = new Profiler();
+        $assert->int($object->record('foo', 'find', null, 1.0))->eq(0);
+        $position = $object->record('foo', 'findAll', null, 1.0);
+        $assert->int($position)->eq(1);
+        $object->addDocuments($position, 2);
+        $object->addDocuments($position, 1);
+        $object->addDocuments(5, 1);
+        $assert->int($object->getCommands()[0]['documents'])->eq(0);
+        $assert->int($object->getCommands()[1]['documents'])->eq(3);
+    }
+
+    <<Test>>
+    public async function testUnsubscribe(Assert $assert): Awaitable<void>
+    {
+        $object = new Profiler();
+        $object->unsubscribe();
+        $assert->bool($object->isSubscribed())->is(false);
+        if ($object->subscribe('labrys_test')) {
+            $assert->bool($object->isSubscribed())->is(true);
+            $object->unsubscribe();
+        }
+        $assert->bool($object->isSubscribed())->is(false);
+    }
+}
@@ -0,0 +1,49 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+use MongoDB\Driver\ReadPreference;
+
+class ReadRouterTest
+{
+    <<Test>>
+    public async function testRoute(Assert $assert): Awaitable<void>
+    {
+        $store = new \ArrayObject();
+        $object = new ReadRouter(120, 5, $store);
+        $assert->bool($object->isPinned())->is(false);
+        $assert->int($object->getReadPreference()->getMode())->eq(ReadPreference::RP_SECONDARY_PREFERRED);
+        $object->recordWrite();
+        $assert->bool($object->isPinned())->is(true);
+        $assert->int($object->getReadPreference()->getMode())->eq(ReadPreference::RP_PRIMARY);
+        $next = new ReadRouter(120, 5, $store);
+        $assert->bool($next->isPinned())->is(true);
+        $assert->float($next->getLastWrite())->eq($object->getLastWrite());
+    }
+
+    <<Test>>
+    public async function testStaleness(Assert $assert): Awaitable<void>
+    {
+        $assert->whenCalled(function () {
+            new ReadRouter(10);
+        })->willThrowClass(\InvalidArgumentException::class);
+    }
+}
@@ -0,0 +1,57 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+
+class SharedDocumentCacheTest
+{
+    <<Test>>
+    public async function testStore(Assert $assert): Awaitable<void>
+    {
+        $object = new SharedDocumentCache(uniqid('test'));
+        $object->store('a', 0, 'first');
+        $object->store('a', 0, 'second');
+        $assert->mixed($object->fetch('a'))->identicalTo('first');
+        $object->store('a', 1, 'third');
+        $assert->mixed($object->fetch('a'))->identicalTo('third');
+        $object->store('a', 0, 'older');
+        $assert->mixed($object->fetch('a'))->identicalTo('third');
+        $object->store('b', 2, 'fourth');
+        $assert->mixed($object->fetchAll(ImmVector{'a', 'b', 'c'})->toArray())
+            ->looselyEquals(['a' => 'third', 'b' => 'fourth']);
+    }
+
+    <<Test>>
+    public async function testInvalidate(Assert $assert): Awaitable<void>
+    {
+        $object = new SharedDocumentCache(uniqid('test'));
+        $object->store('a', 0, 'first');
+        $object->invalidate('a');
+        $assert->mixed($object->fetch('a'))->isNull();
+        $object->store('a', 0, 'stale');
+        $assert->mixed($object->fetch('a'))->isNull();
+        $object = new SharedDocumentCache(uniqid('test'), 300, 'labrys', 0);
+        $object->store('a', 0, 'first');
+        $object->invalidate('a');
+        $object->store('a', 0, 'second');
+        $assert->mixed($object->fetch('a'))->identicalTo('second');
+    }
+}
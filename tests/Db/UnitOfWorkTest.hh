@@ -0,0 +1,157 @@
+<?hh
+/**
+ * Labrys
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ *
+ * @copyright 2015-2016 Appertly
+ * @license   Apache-2.0
+ */
+namespace Labrys\Db;
+
+use HackPack\HackUnit\Contract\Assert;
+use MongoDB\BSON\ObjectID;
+use MongoDB\BSON\Persistable;
+use MongoDB\Driver\WriteResult;
+
+class UnitOfWorkTest
+{
+    <<Test>>
+    public async function testDedupe(Assert $assert): Awaitable<void>
+    {
+        $dao = new UnitOfWorkTestDao();
+        $entity = new UnitOfWorkTestEntity('a');
+        $id = new ObjectID();
+        $object = new UnitOfWork();
+        $object->update($dao, $entity)
+            ->update($dao, $entity)
+            ->delete($dao, $entity)
+            ->delete($dao, $entity)
+            ->delete($dao, $id)
+            ->delete($dao, (string) $id)
+            ->delete($dao, 'b');
+        $object->flush();
+        $assert->int($dao->calls->count())->eq(1);
+        list($inserts, $updates, $deletes, $ordered) = $dao->calls[0];
+        $assert->int($updates->count())->eq(1);
+        // the ObjectID and its string are the same identifier
+        $assert->mixed($deletes->toArray())->looselyEquals([$entity, (string) $id, 'b']);
+        $assert->mixed($deletes[0])->identicalTo($entity);
+        $assert->bool($ordered)->is(true);
+    }
+
+    <<Test>>
+    public async function testOrdering(Assert $assert): Awaitable<void>
+    {
+        $first = new UnitOfWorkTestDao();
+        $second = new UnitOfWorkTestDao();
+        $log = Vector{};
+        $first->log = $log;
+        $second->log = $log;
+        $object = new UnitOfWork(false);
+        $object->persist($second, new UnitOfWorkTestEntity('a'))
+            ->persist($first, new UnitOfWorkTestEntity('b'))
+            ->persist($second, new UnitOfWorkTestEntity('c'));
+        $object->flush();
+        $assert->mixed($log->toArray())->looselyEquals([$second, $first]);
+        list($inserts, $updates, $deletes, $ordered) = $second->calls[0];
+        $assert->mixed($inserts->map($a ==> $a->id)->toArray())->looselyEquals(['a', 'c']);
+        $assert->bool($ordered)->is(false);
+    }
+
+    <<Test>>
+    public async function testDeleteAfterInsert(Assert $assert): Awaitable<void>
+    {
+        $dao = new UnitOfWorkTestDao();
+        $entity = new UnitOfWorkTestEntity('a');
+        $object = new UnitOfWork();
+        $object->persist($dao, $entity)->delete($dao, $entity);
+        $object->flush();
+        // a bulk write sends inserts before deletes, so nothing is left
+        list($inserts, $updates, $deletes, $ordered) = $dao->calls[0];
+        $assert->mixed($inserts[0])->identicalTo($entity);
+        $assert->mixed($deletes[0])->identicalTo($entity);
+        $assert->bool($ordered)->is(true);
+    }
+
+    <<Test>>
+    public async function testIsPending(Assert $assert): Awaitable<void>
+    {
+        $good = new UnitOfWorkTestDao();
+        $bad = new UnitOfWorkTestDao();
+        $bad->fail = true;
+        $object = new UnitOfWork();
+        $assert->bool($object->isPending())->is(false);
+        $object->persist($good, new UnitOfWorkTestEntity('a'))
+            ->persist($bad, new UnitOfWorkTestEntity('b'));
+        $assert->bool($object->isPending())->is(true);
+        $assert->whenCalled(function () use ($object) {
+            $object->flush();
+        })->willThrowClass(\Caridea\Dao\Exception\Generic::class);
+        $assert->bool($object->isPending())->is(true);
+        $bad->fail = false;
+        $object->flush();
+        $assert->int($good->calls->count())->eq(1);
+        $assert->int($bad->calls->count())->eq(1);
+        $assert->bool($object->isPending())->is(false);
+        $object->persist($good, new UnitOfWorkTestEntity('c'))->clear();
+        $assert->bool($object->isPending())->is(false);
+    }
+}
+
+class UnitOfWorkTestDao implements BulkWritable
+{
+    public Vector<(ImmVector<Persistable>, ImmVector<Entity\Modifiable>, ImmVector<mixed>, bool)> $calls = Vector{};
+    public ?Vector<BulkWritable> $log;
+    public bool $fail = false;
+
+    public function writeBulk(
+        \ConstVector<Persistable> $inserts,
+        \ConstVector<Entity\Modifiable> $updates,
+        \ConstVector<mixed> $deletes,
+        bool $ordered = true,
+    ): ?WriteResult {
+        if ($this->fail) {
+            throw new \Caridea\Dao\Exception\Generic('Failed');
+        }
+        $this->calls[] = tuple($inserts->toImmVector(), $updates->toImmVector(), $deletes->toImmVector(), $ordered);
+        $this->log?->add($this);
+        return null;
+    }
+}
+
+class UnitOfWorkTestEntity implements Entity\Modifiable
+{
+    public function __construct(public string $id)
+    {
+    }
+
+    public function isDirty(): bool
+    {
+        return true;
+    }
+
+    public function getChanges(): \ConstMap<string,Map<string,mixed>>
+    {
+        return Map{'$set' => Map{'id' => $this->id}};
+    }
+
+    public function bsonSerialize(): array
+    {
+        return ['_id' => $this->id];
+    }
+
+    public function bsonUnserialize(array $data): void
+    {
+    }
+}
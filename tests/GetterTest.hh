@@ -61,6 +61,33 @@ class GetterTest
         $assert->mixed(Getter::getId($this))->looselyEquals('foobar');
     }
 
+    <<Test>>
+    public async function testDynamicProperty(Assert $assert): Awaitable<void>
+    {
+        $object = new GetterTestMagic();
+        $assert->mixed(Getter::get($object, 'extra'))->looselyEquals('magic:extra');
+        $assert->mixed(Getter::getId($object))->looselyEquals('magic:id');
+        $object->extra = 'dynamic';
+        $object->_id = 'abc';
+        $assert->mixed(Getter::get($object, 'extra'))->looselyEquals('dynamic');
+        $assert->mixed(Getter::getId($object))->looselyEquals('abc');
+
+        $plain = new GetterTestPlain();
+        $assert->mixed(Getter::get($plain, 'extra'))->identicalTo(null);
+        $plain->extra = 123;
+        $assert->mixed(Getter::get($plain, 'extra'))->looselyEquals(123);
+        $assert->mixed(Getter::get(new GetterTestPlain(), 'extra'))->identicalTo(null);
+    }
+
+    <<Test>>
+    public async function testMagicGet(Assert $assert): Awaitable<void>
+    {
+        $object = new GetterTestMagic();
+        $assert->mixed(Getter::get($object, 'name'))->looselyEquals('magic:name');
+        $assert->mixed(Getter::get($object, 'other'))->looselyEquals('magic:other');
+        $assert->mixed(Getter::getId($object))->looselyEquals('magic:id');
+    }
+
     public function getFoo()
     {
         return 'bar';
@@ -71,3 +98,15 @@ class GetterTest
         return 'foobar';
     }
 }
+
+class GetterTestPlain
+{
+}
+
+class GetterTestMagic
+{
+    public function __get($name)
+    {
+        return "magic:$name";
+    }
+}
@@ -91,4 +91,42 @@ class JsonHelperTest
         $assert->string((string)$output->getBody())->is(json_encode($items));
         $assert->string($output->getHeaderLine('Content-Range'))->is('items 0-2/9');
     }
+
+    <<Test>>
+    public async function testSendJsonItems(Assert $assert): Awaitable<void>
+    {
+        $response = new \Zend\Diactoros\Response();
+        $pagination = new \Caridea\Http\Pagination(2, 4);
+        $items = new \Labrys\Db\CursorSubset(Vector{'{"a":1}', '{"b":"c"}'}, 7);
+        $output = $this->sendJsonItems($response, $items, $pagination);
+        $assert->string((string)$output->getBody())->is('[{"a":1},{"b":"c"}]');
+        $assert->string($output->getHeaderLine('Content-Range'))->is('items 4-5/7');
+        $assert->string($output->getHeaderLine('Content-Type'))->is('application/json');
+    }
+
+    <<Test>>
+    public async function testSendJsonItemsEmpty(Assert $assert): Awaitable<void>
+    {
+        $response = new \Zend\Diactoros\Response();
+        $output = $this->sendJsonItems($response, Vector{});
+        $assert->string((string)$output->getBody())->is('[]');
+        $assert->string($output->getHeaderLine('Content-Range'))->is('items 0-0/0');
+    }
+
+    <<Test>>
+    public async function testSendItemsStreamed(Assert $assert): Awaitable<void>
+    {
+        $response = new \Zend\Diactoros\Response();
+        $pagination = new \Caridea\Http\Pagination(2, 0);
+        $items = \Labrys\Db\CursorSubset::deferred(self::generate(), () ==> 12);
+        $output = $this->sendItems($response, $items, $pagination);
+        $assert->string((string)$output->getBody())->is('[{"n":0},{"n":1}]');
+        $assert->string($output->getHeaderLine('Content-Range'))->is('items 0-1/12');
+    }
+
+    private static function generate(): \Generator<int,Map<string,int>,void>
+    {
+        yield Map{'n' => 0};
+        yield Map{'n' => 1};
+    }
 }